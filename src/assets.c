@@ -9,7 +9,10 @@
 
 #include "assets.h"
 #include "game.h"
+#include "memory.h"
 #include "pcgrandom.h"
+#include "regions.h"
+#include "tilemap.h"
 
 #define COLOR_GRASS 0xffffffff
 #define COLOR_ROCK 0xff44C4FF
@@ -119,11 +122,12 @@ static uint32_t get_png_pixel(uint32_t x, uint32_t y, Png *png)
     }
 }
 
-SDL_Texture *load_sprites(const char *filename)
+// If pixels_copy isn't NULL, the final ARGB8888 sheet is also copied there (SPRITE_SHEET_SIZE squared pixels) for the software renderer.
+SDL_Texture *load_sprites(const char *filename, uint32_t *pixels_copy)
 {
     Png png;
     load_png(filename, &png);
-    if (png.width != 256 || png.height != 256) {
+    if (png.width != SPRITE_SHEET_SIZE || png.height != SPRITE_SHEET_SIZE) {
         fprintf(stderr, "Invalid sprite size. Width: %u Height: %u\n", png.width, png.height);
         exit(EXIT_FAILURE);
     }
@@ -156,6 +160,11 @@ SDL_Texture *load_sprites(const char *filename)
             pixels[(dst_y * png.width) + dst_x] = color;
         }
     }
+    if (pixels_copy) {
+        for (int y = 0; y < SPRITE_SHEET_SIZE; y++) {
+            memcpy(pixels_copy + (y * SPRITE_SHEET_SIZE), (uint8_t *)surface->pixels + (y * surface->pitch), SPRITE_SHEET_SIZE * sizeof(uint32_t));
+        }
+    }
     SDL_UnlockSurface(surface);
     destroy_png(&png);
     SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer.sdl, surface);
@@ -167,20 +176,7 @@ SDL_Texture *load_sprites(const char *filename)
     return texture;
 }
 
-static void set_tree_collision(TileMap *tile_map, int x, int y)
-{
-    if (x + 1 < tile_map->width) {
-        tile_map->tiles[(y * tile_map->width) + x + 1] |= SOLID;
-    }
-    if (y + 1 < tile_map->height) {
-        tile_map->tiles[((y + 1) * tile_map->width) + x] |= SOLID;
-        if (x + 1 < tile_map->width) {
-            tile_map->tiles[((y + 1) * tile_map->width) + x + 1] |= SOLID;
-        }
-    }
-}
-
-void load_level(TileMap *tile_map, const char *filename)
+void load_level(TileMap *tile_map, const char *filename, RngState *rng)
 {
     Png png;
     load_png(filename, &png);
@@ -190,7 +186,7 @@ void load_level(TileMap *tile_map, const char *filename)
         fprintf(stderr, "Invalid tilemap dementions. Width: %d Height: %d\n", tile_map->width, tile_map->height);
         exit(EXIT_FAILURE);
     }
-    tile_map->tiles = calloc(tile_map->width * tile_map->height, sizeof(uint16_t));
+    tile_map->tiles = tracked_calloc(MEMORY_ASSETS, tile_map->width * tile_map->height, sizeof(uint16_t));
     if (tile_map->tiles == NULL) {
         fprintf(stderr, "calloc failed\n");
         exit(EXIT_FAILURE);
@@ -201,7 +197,7 @@ void load_level(TileMap *tile_map, const char *filename)
             uint32_t color = get_png_pixel(x, y, &png);
             switch (color) {
                 case COLOR_GRASS:
-                    if (pcg_ranged_random(8) == 0) {
+                    if (pcg_ranged_random(rng, 8) == 0) {
                         *dst |= TILE_GRASS;
                     }
                     break;
@@ -219,7 +215,7 @@ void load_level(TileMap *tile_map, const char *filename)
                     break;
                 case COLOR_TORCH:
                     *dst |= TILE_TORCH;
-                    if (pcg_ranged_random(8) == 0) {
+                    if (pcg_ranged_random(rng, 8) == 0) {
                         *dst |= TILE_GRASS;
                     }
                     break;
@@ -232,4 +228,6 @@ void load_level(TileMap *tile_map, const char *filename)
         }
     }
     destroy_png(&png);
+    tile_map->dirty.count = 0;
+    build_regions(tile_map);
 }
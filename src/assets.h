@@ -1,11 +1,16 @@
 #ifndef ASSETS_H
 #define ASSETS_H
 
+#include <stdint.h>
+
 #include "SDL.h"
 
 #include "game.h"
+#include "pcgrandom.h"
+
+#define SPRITE_SHEET_SIZE 256
 
-SDL_Texture *load_sprites(const char *filename);
-void load_level(TileMap *tile_map, const char *filename);
+SDL_Texture *load_sprites(const char *filename, uint32_t *pixels_copy);
+void load_level(TileMap *tile_map, const char *filename, RngState *rng);
 
 #endif
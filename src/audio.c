@@ -1,12 +1,35 @@
 #include "SDL.h"
-#include <samplerate.h>
+#include <math.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "audio.h"
+#include "memory.h"
+#include "pacer.h"
+#include "resample.h"
 
-#define MAX_SFX 8
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AUDIO_SSE2
+#endif
+
+// Voices are kept packed at the front of the array so the mixer only walks the ones that are playing.
+#define MAX_VOICES 256
+// Play requests go through a lock free queue so play_sound never blocks on the audio thread. Must be a power of 2.
+#define REQUEST_QUEUE_SIZE 512
+#define PI 3.14159265358979323846f
+
+// Load requests for the loader thread. Each clip is queued at most once so this only needs room for all of them.
+#define LOAD_QUEUE_SIZE 16
+
+// Buffer sizes in frames. Normal mode asks for the old 4096 (~85ms at 48kHz).
+// Low latency mode starts at 256 (~5ms) and doubles whenever underruns show up, up to the normal size.
+#define NORMAL_BUFFER_FRAMES 4096
+#define LOW_LATENCY_BUFFER_FRAMES 256
+// Underruns within one second that trigger a bigger buffer.
+#define UNDERRUN_GROW_THRESHOLD 2
 
 typedef struct AudioStream
 {
@@ -14,63 +37,344 @@ typedef struct AudioStream
     uint32_t position;
 } AudioStream;
 
-AudioData breed;
-AudioData game_over;
-AudioData menu;
-AudioData menu_cycle;
-AudioData menu_theme;
-AudioData start;
-AudioData theme;
+typedef struct Voice
+{
+    AudioData *audio_data;
+    uint32_t position;
+    uint32_t delay;  // Frames of silence before the voice starts in the current callback
+    float left_gain;
+    float right_gain;
+    uint8_t priority;
+} Voice;
+
+typedef struct PlayRequest
+{
+    AudioData *audio_data;
+    int64_t time;
+    float gain;
+    float pan;
+    uint8_t priority;
+} PlayRequest;
+
+AudioData breed = {.filename = "res/sound/breed.wav"};
+AudioData game_over = {.filename = "res/sound/gameover.wav"};
+AudioData menu = {.filename = "res/sound/menu.wav"};
+AudioData menu_cycle = {.filename = "res/sound/menucycle.wav"};
+AudioData menu_theme = {.filename = "res/sound/menutheme.wav"};
+AudioData start = {.filename = "res/sound/start.wav"};
+AudioData theme = {.filename = "res/sound/theme.wav"};
+static AudioData *const all_sounds[] = {&breed, &game_over, &menu, &menu_cycle, &menu_theme, &start, &theme};
 
 static SDL_AudioDeviceID audio_device;
+static int sample_rate;
 static AudioStream music = {&theme, 0};
-static AudioStream sound_effects[MAX_SFX];
+static Voice voices[MAX_VOICES];
+static int num_voices;
+static int64_t last_callback_time;
+static bool low_latency;
+static int64_t stats_window_start;
+static uint32_t callbacks_since_open;
+/*
+ * stats is the window the callback is adding to and published the last full one. update_audio rolls one into the other once a second.
+ * Both are guarded by stats_lock rather than the device lock since the metrics thread reads them while update_audio may be reopening the device.
+ */
+static SDL_SpinLock stats_lock;
+static AudioStats stats;
+static AudioStats published;
+static PlayRequest requests[REQUEST_QUEUE_SIZE];
+static SDL_atomic_t request_head;  // Only written by the audio thread
+static SDL_atomic_t request_tail;  // Only written by the thread calling play_sound
+static int resample_quality;
+static SDL_Thread *loader_thread;
+static SDL_mutex *load_mutex;
+static SDL_cond *load_cond;
+static AudioData *load_queue[LOAD_QUEUE_SIZE];
+static int load_head;
+static int load_tail;
+
+static void load_wav(const char *filename, AudioData *audio_data, int frequency, int quality);
+
+/*
+ * Decodes queued clips one at a time. Publishing AUDIO_READY is the last write so the mixer never sees a half loaded clip.
+ * Runs for the life of the process. Clips are never unloaded.
+ */
+static int loader_main(void *data)
+{
+    (void)data;
+    for (;;) {
+        SDL_LockMutex(load_mutex);
+        while (load_head == load_tail) {
+            SDL_CondWait(load_cond, load_mutex);
+        }
+        AudioData *audio_data = load_queue[load_head % LOAD_QUEUE_SIZE];
+        load_head++;
+        SDL_UnlockMutex(load_mutex);
+
+        load_wav(audio_data->filename, audio_data, sample_rate, resample_quality);
+        SDL_AtomicSet(&audio_data->state, AUDIO_READY);
+    }
+    return 0;
+}
+
+/*
+ * Hands a clip to the loader thread unless it is already loaded or on its way. Never waits on the load itself.
+ * Safe to call from any thread, including before the first frame to hide the load behind startup.
+ */
+void prefetch_sound(AudioData *audio_data)
+{
+    if (!SDL_AtomicCAS(&audio_data->state, AUDIO_UNLOADED, AUDIO_QUEUED)) {
+        return;
+    }
+    SDL_LockMutex(load_mutex);
+    load_queue[load_tail % LOAD_QUEUE_SIZE] = audio_data;
+    load_tail++;
+    SDL_CondSignal(load_cond);
+    SDL_UnlockMutex(load_mutex);
+}
+
+// Queues every clip. For when load timing matters more than startup cost, like --alloc-check where lazy loads would be reported.
+void prefetch_all_sounds(void)
+{
+    for (size_t i = 0; i < SDL_arraysize(all_sounds); i++) {
+        prefetch_sound(all_sounds[i]);
+    }
+}
+
+bool all_sounds_ready(void)
+{
+    for (size_t i = 0; i < SDL_arraysize(all_sounds); i++) {
+        if (SDL_AtomicGet(&all_sounds[i]->state) != AUDIO_READY) {
+            return false;
+        }
+    }
+    return true;
+}
 
 void play_sound(AudioData *audio_data)
 {
-    static int index = 0;
-    SDL_LockAudioDevice(audio_device);
-    sound_effects[index].audio_data = audio_data;
-    sound_effects[index].position = 0;
-    index++;
-    if (index >= MAX_SFX) {
-        index = 0;
+    play_sound_ex(audio_data, 1.0f, 0.0f, SOUND_PRIORITY_NORMAL);
+}
+
+/*
+ * Queues a sound to start at the current time. Pan goes from -1 (left) to 1 (right).
+ * Should only be called from one thread at a time (the one running update_game).
+ * If the queue is full the request is dropped, same as if it lost voice stealing.
+ * A clip that hasn't finished loading is dropped the same way and starts loading so later plays are heard.
+ */
+void play_sound_ex(AudioData *audio_data, float gain, float pan, uint8_t priority)
+{
+    if (SDL_AtomicGet(&audio_data->state) != AUDIO_READY) {
+        prefetch_sound(audio_data);
+        return;
+    }
+    int tail = SDL_AtomicGet(&request_tail);
+    int head = SDL_AtomicGet(&request_head);
+    if (tail - head >= REQUEST_QUEUE_SIZE) {
+        return;
+    }
+    PlayRequest *request = &requests[tail & (REQUEST_QUEUE_SIZE - 1)];
+    request->audio_data = audio_data;
+    request->time = get_time_ns();
+    request->gain = gain;
+    request->pan = pan;
+    request->priority = priority;
+    SDL_AtomicSet(&request_tail, tail + 1);
+}
+
+/*
+ * Returns a slot for a new voice of the given priority or NULL if every voice is more important.
+ * When full, steals the lowest priority voice, preferring the one closest to finishing.
+ */
+static Voice *allocate_voice(uint8_t priority)
+{
+    if (num_voices < MAX_VOICES) {
+        return &voices[num_voices++];
+    }
+    Voice *victim = NULL;
+    for (int i = 0; i < num_voices; i++) {
+        Voice *voice = &voices[i];
+        if (voice->priority > priority) {
+            continue;
+        }
+        if (victim == NULL || voice->priority < victim->priority ||
+            (voice->priority == victim->priority && voice->audio_data->samples - voice->position < victim->audio_data->samples - victim->position)) {
+            victim = voice;
+        }
+    }
+    return victim;
+}
+
+/*
+ * Moves queued requests into voices. Each request is placed at the same offset into this buffer as it was made after the previous callback.
+ * That gives every sound a constant one buffer latency instead of jittering between zero and one buffer.
+ */
+static void start_requested_voices(uint32_t requested_samples)
+{
+    int head = SDL_AtomicGet(&request_head);
+    int tail = SDL_AtomicGet(&request_tail);
+    for (; head != tail; head++) {
+        const PlayRequest *request = &requests[head & (REQUEST_QUEUE_SIZE - 1)];
+        Voice *voice = allocate_voice(request->priority);
+        if (voice == NULL) {
+            continue;
+        }
+        int64_t offset = ((request->time - last_callback_time) * sample_rate) / NS_PER_SECOND;
+        if (offset < 0) {
+            offset = 0;
+        } else if (offset >= requested_samples) {
+            offset = requested_samples - 1;
+        }
+        // Constant power pan law so panned sounds aren't quieter than centered ones.
+        float angle = (SDL_min(SDL_max(request->pan, -1.0f), 1.0f) + 1.0f) * (PI * 0.25f);
+        voice->audio_data = request->audio_data;
+        voice->position = 0;
+        voice->delay = offset;
+        voice->left_gain = request->gain * cosf(angle) * 1.41421356f;
+        voice->right_gain = request->gain * sinf(angle) * 1.41421356f;
+        voice->priority = request->priority;
+    }
+    SDL_AtomicSet(&request_head, head);
+}
+
+/*
+ * Converts int16 PCM to stereo float, applies per channel gain and writes or adds it to output.
+ * Mono input is written to both channels.
+ */
+static void mix_pcm(float *output, const int16_t *input, uint32_t frames, uint8_t channels, float left_gain, float right_gain, bool add)
+{
+    const float scale = 1.0f / 32768.0f;
+    const float gains[2] = {left_gain * scale, right_gain * scale};
+    uint32_t i = 0;
+    if (channels == 2) {
+        uint32_t count = frames * 2;
+        #ifdef AUDIO_SSE2
+        __m128 vscale = _mm_set_ps(gains[1], gains[0], gains[1], gains[0]);
+        for (; i + 8 <= count; i += 8) {
+            __m128i pcm = _mm_loadu_si128((const __m128i *)(input + i));
+            // Unpacking a vector with itself then shifting right sign extends each int16 to int32.
+            __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16)), vscale);
+            __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16)), vscale);
+            if (add) {
+                lo = _mm_add_ps(lo, _mm_loadu_ps(output + i));
+                hi = _mm_add_ps(hi, _mm_loadu_ps(output + i + 4));
+            }
+            _mm_storeu_ps(output + i, lo);
+            _mm_storeu_ps(output + i + 4, hi);
+        }
+        #endif
+        for (; i < count; i++) {
+            float sample = input[i] * gains[i & 1];
+            output[i] = add ? output[i] + sample : sample;
+        }
+    } else {
+        #ifdef AUDIO_SSE2
+        __m128 vscale = _mm_set1_ps(scale);
+        __m128 vgain = _mm_set_ps(right_gain, left_gain, right_gain, left_gain);
+        for (; i + 8 <= frames; i += 8) {
+            __m128i pcm = _mm_loadu_si128((const __m128i *)(input + i));
+            __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16)), vscale);
+            __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16)), vscale);
+            __m128 out[4];
+            out[0] = _mm_unpacklo_ps(lo, lo);
+            out[1] = _mm_unpackhi_ps(lo, lo);
+            out[2] = _mm_unpacklo_ps(hi, hi);
+            out[3] = _mm_unpackhi_ps(hi, hi);
+            for (int v = 0; v < 4; v++) {
+                out[v] = _mm_mul_ps(out[v], vgain);
+                if (add) {
+                    out[v] = _mm_add_ps(out[v], _mm_loadu_ps(output + (i * 2) + (v * 4)));
+                }
+                _mm_storeu_ps(output + (i * 2) + (v * 4), out[v]);
+            }
+        }
+        #endif
+        for (; i < frames; i++) {
+            if (add) {
+                output[i * 2] += input[i] * gains[0];
+                output[(i * 2) + 1] += input[i] * gains[1];
+            } else {
+                output[i * 2] = input[i] * gains[0];
+                output[(i * 2) + 1] = input[i] * gains[1];
+            }
+        }
+    }
+}
+
+/*
+ * Callbacks should arrive once per buffer period. One that arrives well after that means the device was
+ * probably left without data, and a callback that takes longer than the period can't keep up at all.
+ */
+static void record_callback_timing(int64_t callback_start, int64_t callback_end, uint32_t frames)
+{
+    int64_t period = ((int64_t)frames * NS_PER_SECOND) / sample_rate;
+    int64_t duration = callback_end - callback_start;
+    SDL_AtomicLock(&stats_lock);
+    stats.buffer_frames = frames;
+    stats.period_ns = period;
+    stats.callbacks++;
+    stats.total_callback_ns += duration;
+    if (duration > stats.max_callback_ns) {
+        stats.max_callback_ns = duration;
     }
-    SDL_UnlockAudioDevice(audio_device);
+    bool underrun = duration > period;
+    if (callbacks_since_open > 0) {
+        int64_t interval = callback_start - last_callback_time;
+        if (interval > period + (period / 4)) {
+            stats.late_callbacks++;
+        }
+        if (interval > period * 2) {
+            underrun = true;
+        }
+    }
+    if (underrun) {
+        stats.underruns++;
+    }
+    SDL_AtomicUnlock(&stats_lock);
+    callbacks_since_open++;
 }
 
 static void audio_callback(void *userdata, Uint8 *stream, int len)
 {
-    int requested_samples = (len / sizeof(float)) / 2;  // Output is always 2 channel
+    int64_t callback_start = get_time_ns();
+    uint32_t requested_samples = (len / sizeof(float)) / 2;  // Output is always 2 channel
     float *output = (float *)stream;
-    for (int s = 0; s < requested_samples; s++) {
-        *output++ = music.audio_data->data[music.position * music.audio_data->channels];
-        // For mono sound input, write the same data to both channels
-        *output++ = music.audio_data->data[(music.position * music.audio_data->channels) + (music.audio_data->channels - 1)];
-        music.position += 1;
+    uint32_t done = 0;
+    if (SDL_AtomicGet(&music.audio_data->state) != AUDIO_READY) {
+        // Silence until the music has loaded rather than holding up the first frame for it.
+        memset(output, 0, requested_samples * 2 * sizeof(float));
+        done = requested_samples;
+    }
+    while (done < requested_samples) {
+        uint32_t frames = SDL_min(requested_samples - done, music.audio_data->samples - music.position);
+        mix_pcm(output + (done * 2), music.audio_data->data + (music.position * music.audio_data->channels), frames, music.audio_data->channels, 1.0f, 1.0f, false);
+        done += frames;
+        music.position += frames;
         if (music.position >= music.audio_data->samples) {
             music.position = 0;
         }
     }
 
-    for (int i = 0; i < MAX_SFX; i++) {
-        if (sound_effects[i].audio_data) {
-            output = (float *)stream;
-            for (int s = 0; s < requested_samples; s++) {
-                *output++ += sound_effects[i].audio_data->data[sound_effects[i].position * sound_effects[i].audio_data->channels];
-                // For mono sound input, write the same data to both channels
-                *output++ += sound_effects[i].audio_data->data[(sound_effects[i].position * sound_effects[i].audio_data->channels) + (sound_effects[i].audio_data->channels - 1)];
-                sound_effects[i].position += 1;
-                if (sound_effects[i].position >= sound_effects[i].audio_data->samples) {
-                    memset(sound_effects + i, 0, sizeof(AudioStream));
-                    break;
-                }
-            }
+    start_requested_voices(requested_samples);
+    for (int i = 0; i < num_voices;) {
+        Voice *voice = &voices[i];
+        AudioData *audio_data = voice->audio_data;
+        uint32_t frames = SDL_min(requested_samples - voice->delay, audio_data->samples - voice->position);
+        mix_pcm(output + (voice->delay * 2), audio_data->data + (voice->position * audio_data->channels), frames, audio_data->channels, voice->left_gain, voice->right_gain, true);
+        voice->position += frames;
+        voice->delay = 0;
+        if (voice->position >= audio_data->samples) {
+            // Swap the last voice into this slot to keep the active voices packed.
+            num_voices--;
+            *voice = voices[num_voices];
+        } else {
+            i++;
         }
     }
+    record_callback_timing(callback_start, get_time_ns(), requested_samples);
+    last_callback_time = callback_start;
 }
 
-static void load_wav(const char *filename, AudioData *audio_data, int frequency)
+static void load_wav(const char *filename, AudioData *audio_data, int frequency, int quality)
 {
     SDL_AudioSpec audio_spec;
     int16_t *wav_data;
@@ -89,84 +393,155 @@ static void load_wav(const char *filename, AudioData *audio_data, int frequency)
     }
     audio_data->channels = audio_spec.channels;
     audio_data->samples = (audio_len / sizeof(int16_t)) / audio_data->channels;
-    float *float_data = malloc(audio_data->samples * audio_data->channels * sizeof(float));
+    // The mixer loops the music until it has filled the buffer, which would never end on an empty clip.
+    if (audio_data->samples == 0) {
+        fprintf(stderr, "%s: Clip has no samples\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    if (audio_spec.freq == frequency) {
+        // Already in the format we mix from. Keep SDL's buffer rather than copying it.
+        audio_data->data = wav_data;
+        return;
+    }
+    /*
+     * Resample if the frequency doesn't match what the system can support.
+     * We ask SDL for a 48000 frequency which is what the large music files are.
+     * This should be supported by most systems natively.  However, if it's not, SDL can give us back a different frequency.
+     * I wanted to avoid using SDL's resampler as it is somewhat buggy:
+     * https://github.com/libsdl-org/SDL/issues/6391
+     * https://github.com/libsdl-org/SDL/issues/7358
+     * See resample.c for the quality options. RESAMPLE_REFERENCE is the old libsamplerate path which takes ~30 seconds on the music.
+     * The resampler works in float. The result goes back to int16 so resident audio is half the size.
+     */
+    size_t input_count = (size_t)audio_data->samples * audio_data->channels;
+    float *float_data = tracked_malloc(MEMORY_AUDIO, input_count * sizeof(float));
     if (float_data == NULL) {
         fprintf(stderr, "malloc failed\n");
         exit(EXIT_FAILURE);
     }
-    for (uint32_t i = 0; i < audio_data->samples * audio_data->channels; i++) {
+    for (size_t i = 0; i < input_count; i++) {
         float_data[i] = wav_data[i] * (1.0f / 32768.0f);
     }
     SDL_FreeWAV((Uint8 *)wav_data);
-    if (audio_spec.freq == frequency) {
-        audio_data->data = float_data;
-    } else {
-        /* 
-         * Use libsample rate to convert if the frequency doesn't match what the system can support.
-         * This converter is slow for large files. We ask SDL for a 48000 frequency which is what the large music files are.
-         * This should be supported by most systems natively.  However, if it's not, SDL can give us back a different frequency.
-         * If the music files need converted, it can take ~30 seoncds.  Even though this only happens once at the start of the game, it's still a long load time.
-         * The sound effects go through this path but they only take 1 second or so.
-         * If this is a problem, maybe look for an alternative.  I wanted to avoid using SDL's resampler as it is somewhat buggy:
-         * https://github.com/libsdl-org/SDL/issues/6391
-         * https://github.com/libsdl-org/SDL/issues/7358
-         */
-        SRC_DATA src_data;
-        memset(&src_data, 0, sizeof(SRC_DATA));
-        uint32_t allocated_samples = audio_data->samples * 2;
-        src_data.input_frames = audio_data->samples;
-        src_data.output_frames = allocated_samples;
-        src_data.src_ratio = (double)frequency / (double)audio_spec.freq;
-        src_data.data_in = float_data;
-        src_data.data_out = malloc(allocated_samples * audio_data->channels * sizeof(float));
-        if (src_data.data_out == NULL) {
-            fprintf(stderr, "malloc failed\n");
-            exit(EXIT_FAILURE);
-        }
-        int error = src_simple(&src_data, SRC_SINC_BEST_QUALITY, audio_data->channels);
-        if (error) {
-            fprintf(stderr, "src_simple failed: %s\n", src_strerror(error));
-            exit(EXIT_FAILURE);
-        }
-        free(float_data);
-        // The API doesn't tell you ahead of times how many samples it will generate.
-        // We ask for twice as many and then free the un-used memory with realloc.
-        audio_data->samples = src_data.output_frames_gen;
-        if (audio_data->samples < allocated_samples) {
-            src_data.data_out = realloc(src_data.data_out, audio_data->samples * audio_data->channels * sizeof(float));
-            if (src_data.data_out == NULL) {
-                fprintf(stderr, "realloc failed\n");
-                exit(EXIT_FAILURE);
-            }
+    uint32_t output_frames = get_resampled_frames(audio_data->samples, audio_spec.freq, frequency);
+    size_t output_count = (size_t)output_frames * audio_data->channels;
+    float *resampled = tracked_malloc(MEMORY_AUDIO, output_count * sizeof(float));
+    if (resampled == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    resample(float_data, audio_data->samples, audio_data->channels, audio_spec.freq, resampled, frequency, quality);
+    tracked_free(float_data);
+    audio_data->data = tracked_malloc(MEMORY_AUDIO, output_count * sizeof(int16_t));
+    if (audio_data->data == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < output_count; i++) {
+        float sample = resampled[i] * 32768.0f;
+        if (sample > 32767.0f) {
+            sample = 32767.0f;
+        } else if (sample < -32768.0f) {
+            sample = -32768.0f;
         }
-        audio_data->data = src_data.data_out;
+        audio_data->data[i] = (int16_t)lrintf(sample);
     }
+    tracked_free(resampled);
+    audio_data->samples = output_frames;
 }
 
-void init_audio(void)
+static SDL_AudioSpec open_audio_device(int frequency, uint16_t frames, int allowed_changes)
 {
     SDL_AudioSpec desired;
     memset(&desired, 0, sizeof(SDL_AudioSpec));
-    desired.freq = 48000;
+    desired.freq = frequency;
     desired.format = AUDIO_F32LSB;
     desired.channels = 2;
-    desired.samples = 4096;
+    desired.samples = frames;
     desired.callback = audio_callback;
 
     SDL_AudioSpec obtained;
-    audio_device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    audio_device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, allowed_changes);
     if (audio_device == 0) {
         fprintf(stderr, "SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
         exit(EXIT_FAILURE);
     }
+    callbacks_since_open = 0;
+    last_callback_time = get_time_ns();
+    return obtained;
+}
 
-    load_wav("res/sound/breed.wav", &breed, obtained.freq);
-    load_wav("res/sound/gameover.wav", &game_over, obtained.freq);
-    load_wav("res/sound/menu.wav", &menu, obtained.freq);
-    load_wav("res/sound/menucycle.wav", &menu_cycle, obtained.freq);
-    load_wav("res/sound/menutheme.wav", &menu_theme, obtained.freq);
-    load_wav("res/sound/start.wav", &start, obtained.freq);
-    load_wav("res/sound/theme.wav", &theme, obtained.freq);
+/*
+ * Opens the device and starts the loader thread. Only the clips the game plays straight away are prefetched.
+ * Everything else loads the first time it's played or prefetched so startup time and memory don't pay for unused sounds.
+ */
+void init_audio(int quality, bool low_latency_mode)
+{
+    low_latency = low_latency_mode;
+    resample_quality = quality;
+    uint16_t frames = low_latency ? LOW_LATENCY_BUFFER_FRAMES : NORMAL_BUFFER_FRAMES;
+    SDL_AudioSpec obtained = open_audio_device(48000, frames, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    sample_rate = obtained.freq;
+    stats.buffer_frames = obtained.samples;
+    stats.period_ns = ((int64_t)obtained.samples * NS_PER_SECOND) / sample_rate;
+    published = stats;
+    stats_window_start = get_time_ns();
 
+    load_mutex = SDL_CreateMutex();
+    load_cond = SDL_CreateCond();
+    if (load_mutex == NULL || load_cond == NULL) {
+        fprintf(stderr, "Failed to create audio loader mutex: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    loader_thread = SDL_CreateThread(loader_main, "audio loader", NULL);
+    if (loader_thread == NULL) {
+        fprintf(stderr, "SDL_CreateThread failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    SDL_DetachThread(loader_thread);
+    prefetch_sound(&theme);
+    prefetch_sound(&breed);
+
+    SDL_PauseAudioDevice(audio_device, 0);
+}
+
+/*
+ * Called once per frame from the main thread. Publishes the last second's callback stats for get_audio_stats.
+ * In low latency mode, reopens the device with double the buffer if the last second had underruns.
+ * The device is reopened at the same frequency (clips are resampled to it, including any still loading). Music and voices carry on from where they were.
+ */
+void update_audio(void)
+{
+    int64_t now = get_time_ns();
+    if (now - stats_window_start < NS_PER_SECOND) {
+        return;
+    }
+    stats_window_start = now;
+    SDL_AtomicLock(&stats_lock);
+    published = stats;
+    stats.callbacks = 0;
+    stats.total_callback_ns = 0;
+    stats.max_callback_ns = 0;
+    stats.late_callbacks = 0;
+    stats.underruns = 0;
+    SDL_AtomicUnlock(&stats_lock);
+    if (!low_latency || published.underruns < UNDERRUN_GROW_THRESHOLD || published.buffer_frames >= NORMAL_BUFFER_FRAMES) {
+        return;
+    }
+    SDL_CloseAudioDevice(audio_device);
+    SDL_AudioSpec obtained = open_audio_device(sample_rate, published.buffer_frames * 2, SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    SDL_AtomicLock(&stats_lock);
+    stats.buffer_frames = obtained.samples;
+    stats.period_ns = ((int64_t)obtained.samples * NS_PER_SECOND) / sample_rate;
+    stats.buffer_grows++;
+    SDL_AtomicUnlock(&stats_lock);
     SDL_PauseAudioDevice(audio_device, 0);
 }
+
+// Safe from any thread. Readers all see the same last published second and none of them can reset it.
+void get_audio_stats(AudioStats *audio_stats)
+{
+    SDL_AtomicLock(&stats_lock);
+    *audio_stats = published;
+    SDL_AtomicUnlock(&stats_lock);
+}
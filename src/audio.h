@@ -1,15 +1,42 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "SDL.h"
+
+#define SOUND_PRIORITY_LOW 0
+#define SOUND_PRIORITY_NORMAL 128
+#define SOUND_PRIORITY_HIGH 255
+
+// AudioData load states. A clip starts unloaded and is decoded on the loader thread the first time it is played or prefetched.
+#define AUDIO_UNLOADED 0
+#define AUDIO_QUEUED 1
+#define AUDIO_READY 2
+
 typedef struct AudioData
 {
+    const char *filename;
+    SDL_atomic_t state;  // channels, samples and data are only valid once this is AUDIO_READY
     uint8_t channels;
     uint32_t samples;
-    float *data;
+    int16_t *data;  // Interleaved when channels is 2. Converted to float in the mixer.
 } AudioData;
 
+// Callback timing over the last full second, published by update_audio. buffer_grows is a total.
+typedef struct AudioStats
+{
+    uint32_t buffer_frames;
+    int64_t period_ns;
+    uint32_t callbacks;
+    int64_t total_callback_ns;
+    int64_t max_callback_ns;
+    uint32_t late_callbacks;
+    uint32_t underruns;
+    uint32_t buffer_grows;
+} AudioStats;
+
 extern AudioData breed;
 extern AudioData game_over;
 extern AudioData menu;
@@ -18,7 +45,13 @@ extern AudioData menu_theme;
 extern AudioData start;
 extern AudioData theme;
 
-void init_audio(void);
+void init_audio(int resample_quality, bool low_latency_mode);
+void update_audio(void);
+void get_audio_stats(AudioStats *audio_stats);
+void prefetch_sound(AudioData *audio_data);
+void prefetch_all_sounds(void);
+bool all_sounds_ready(void);
 void play_sound(AudioData *audio_data);
+void play_sound_ex(AudioData *audio_data, float gain, float pan, uint8_t priority);
 
 #endif
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDL.h"
+
+#include "batch.h"
+#include "game.h"
+#include "memory.h"
+#include "pacer.h"
+#include "pcgrandom.h"
+#include "replay.h"
+
+#define MAX_THREADS 64
+
+typedef struct BatchResult
+{
+    uint64_t hash;
+    int64_t time_ns;
+} BatchResult;
+
+typedef struct Batch
+{
+    const char *level;
+    RngState rng;
+    uint8_t children_behavior;
+    const float *deltas;
+    const uint8_t *inputs;
+    uint32_t ticks;
+    int num_worlds;
+    SDL_atomic_t next_world;
+    BatchResult *results;
+} Batch;
+
+/*
+ * World n uses the replay's seed on PCG stream n so every world is different but the whole batch is reproducible.
+ * World 0 is exactly the recorded game and should match the hash from --headless.
+ */
+static void run_world(Batch *batch, int n)
+{
+    int64_t start = get_time_ns();
+    RngState rng = batch->rng;
+    rng.inc = (rng.inc + ((uint64_t)n * 2)) | 1;
+    GameState *game = init_game(0, batch->level, &rng, batch->children_behavior, false);
+    for (uint32_t i = 0; i < batch->ticks; i++) {
+        update_game(game, batch->deltas[i], batch->inputs[i]);
+        swap_game_state(game);
+    }
+    batch->results[n].hash = hash_game_state(game);
+    free_game(game);
+    batch->results[n].time_ns = get_time_ns() - start;
+}
+
+// Worlds are independent so each thread just takes the next world nobody has started until there are none left.
+static int batch_thread(void *data)
+{
+    Batch *batch = data;
+    while (1) {
+        int n = SDL_AtomicAdd(&batch->next_world, 1);
+        if (n >= batch->num_worlds) {
+            break;
+        }
+        run_world(batch, n);
+    }
+    return 0;
+}
+
+// Runs the replay's input on num_worlds independent worlds spread across every core and prints each world's state hash.
+void run_batch(Replay *replay, int num_worlds)
+{
+    uint32_t capacity = 4096;
+    float *deltas = tracked_malloc(MEMORY_GAME, capacity * sizeof(float));
+    uint8_t *inputs = tracked_malloc(MEMORY_GAME, capacity * sizeof(uint8_t));
+    if (deltas == NULL || inputs == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    float delta;
+    uint8_t input;
+    while (read_tick(replay, &delta, &input)) {
+        if (replay->ticks > capacity) {
+            capacity *= 2;
+            deltas = tracked_realloc(MEMORY_GAME, deltas, capacity * sizeof(float));
+            inputs = tracked_realloc(MEMORY_GAME, inputs, capacity * sizeof(uint8_t));
+            if (deltas == NULL || inputs == NULL) {
+                fprintf(stderr, "realloc failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        deltas[replay->ticks - 1] = delta;
+        inputs[replay->ticks - 1] = input;
+    }
+
+    Batch batch;
+    batch.level = replay->level;
+    batch.children_behavior = replay->children_behavior;
+    batch.rng = replay->rng;
+    batch.deltas = deltas;
+    batch.inputs = inputs;
+    batch.ticks = replay->ticks;
+    batch.num_worlds = num_worlds;
+    SDL_AtomicSet(&batch.next_world, 0);
+    batch.results = tracked_calloc(MEMORY_GAME, num_worlds, sizeof(BatchResult));
+    if (batch.results == NULL) {
+        fprintf(stderr, "calloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int num_threads = SDL_GetCPUCount();
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    if (num_threads > num_worlds) {
+        num_threads = num_worlds;
+    }
+    int64_t start = get_time_ns();
+    // The main thread works through the batch too. Threads that fail to start just leave more worlds for it.
+    SDL_Thread *threads[MAX_THREADS];
+    for (int t = 0; t < num_threads - 1; t++) {
+        threads[t] = SDL_CreateThread(batch_thread, "batch", &batch);
+    }
+    batch_thread(&batch);
+    for (int t = 0; t < num_threads - 1; t++) {
+        if (threads[t]) {
+            SDL_WaitThread(threads[t], NULL);
+        }
+    }
+    int64_t total = get_time_ns() - start;
+
+    for (int n = 0; n < num_worlds; n++) {
+        printf("World %d: %.3fms State hash: %016llx\n", n, (double)batch.results[n].time_ns / NS_PER_MS, (unsigned long long)batch.results[n].hash);
+    }
+    double world_ticks = (double)batch.ticks * num_worlds;
+    printf("Simulated %d worlds of %u ticks on %d threads in %.3fms. %.0f ticks per second\n", num_worlds, batch.ticks, num_threads,
+        (double)total / NS_PER_MS, total ? world_ticks * NS_PER_SECOND / total : 0.0);
+    tracked_free(batch.results);
+    tracked_free(deltas);
+    tracked_free(inputs);
+}
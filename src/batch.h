@@ -0,0 +1,8 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "replay.h"
+
+void run_batch(Replay *replay, int num_worlds);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "draw.h"
+#include "font.h"
+#include "game.h"
+
+#define LINE_HEIGHT 30
+
+static DrawStats frame;
+static DrawStats last_frame;
+static DrawStats totals;
+static SDL_Texture *current_target;
+static SDL_Texture *current_texture;
+static int target_width;
+static int target_height;
+
+// Call once at the start of every frame. The frame that just ended becomes last_frame and is added to the totals.
+void begin_draw_frame(void)
+{
+    if (frame.frames > 0) {
+        last_frame = frame;
+        totals.frames += 1;
+        totals.submitted += frame.submitted;
+        totals.culled += frame.culled;
+        totals.texture_binds += frame.texture_binds;
+        totals.target_switches += frame.target_switches;
+        totals.rasterized += frame.rasterized;
+    }
+    memset(&frame, 0, sizeof(DrawStats));
+    frame.frames = 1;
+    // The window can be resized between frames.
+    if (current_target == NULL) {
+        target_width = renderer.width;
+        target_height = renderer.height;
+    }
+}
+
+void get_draw_stats(DrawStats *last, DrawStats *total)
+{
+    *last = last_frame;
+    *total = totals;
+}
+
+void reset_draw_stats(void)
+{
+    memset(&totals, 0, sizeof(DrawStats));
+}
+
+// For callers that cull on their own (like the mob grid) so their savings show up next to ours.
+void count_culled(uint32_t quads)
+{
+    frame.culled += quads;
+}
+
+// The software renderer's version of a submit. Sprites raster_blit clipped away entirely count as culled.
+void draw_count_raster(bool drawn)
+{
+    if (drawn) {
+        frame.rasterized += 1;
+    } else {
+        frame.culled += 1;
+    }
+}
+
+void draw_set_target(SDL_Texture *target)
+{
+    if (target == current_target) {
+        return;
+    }
+    if (SDL_SetRenderTarget(renderer.sdl, target) != 0) {
+        fprintf(stderr, "SDL_SetRenderTarget failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    current_target = target;
+    if (target == NULL) {
+        target_width = renderer.width;
+        target_height = renderer.height;
+    } else {
+        SDL_QueryTexture(target, NULL, NULL, &target_width, &target_height);
+    }
+    frame.target_switches += 1;
+}
+
+void draw_clear(void)
+{
+    SDL_RenderClear(renderer.sdl);
+}
+
+// True if the quad can't touch any pixel of the current target.
+static bool off_target(float x, float y, float w, float h)
+{
+    return x >= target_width || y >= target_height || x + w <= 0.0f || y + h <= 0.0f;
+}
+
+static void submit(SDL_Texture *texture)
+{
+    frame.submitted += 1;
+    if (texture != current_texture) {
+        current_texture = texture;
+        frame.texture_binds += 1;
+    }
+}
+
+// A NULL dstrect means the whole target so it's never culled.
+void draw_copy(SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_Rect *dstrect)
+{
+    if (dstrect && off_target((float)dstrect->x, (float)dstrect->y, (float)dstrect->w, (float)dstrect->h)) {
+        frame.culled += 1;
+        return;
+    }
+    submit(texture);
+    SDL_RenderCopy(renderer.sdl, texture, srcrect, dstrect);
+}
+
+void draw_copy_f(SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_FRect *dstrect)
+{
+    if (dstrect && off_target(dstrect->x, dstrect->y, dstrect->w, dstrect->h)) {
+        frame.culled += 1;
+        return;
+    }
+    submit(texture);
+    SDL_RenderCopyF(renderer.sdl, texture, srcrect, dstrect);
+}
+
+void draw_copy_ex_f(SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_FRect *dstrect, SDL_RendererFlip flip)
+{
+    if (dstrect && off_target(dstrect->x, dstrect->y, dstrect->w, dstrect->h)) {
+        frame.culled += 1;
+        return;
+    }
+    submit(texture);
+    SDL_RenderCopyExF(renderer.sdl, texture, srcrect, dstrect, 0, NULL, flip);
+}
+
+// Debug overlay with the previous frame's numbers. Drawing it adds to the current frame's counts.
+void render_draw_stats(int x, int y)
+{
+    char string_buffer[64];
+    snprintf(string_buffer, sizeof(string_buffer), "Quads: %u", last_frame.submitted);
+    render_string(string_buffer, x, y);
+    snprintf(string_buffer, sizeof(string_buffer), "Culled: %u", last_frame.culled);
+    render_string(string_buffer, x, y + LINE_HEIGHT);
+    snprintf(string_buffer, sizeof(string_buffer), "Texture binds: %u", last_frame.texture_binds);
+    render_string(string_buffer, x, y + (LINE_HEIGHT * 2));
+    snprintf(string_buffer, sizeof(string_buffer), "Target switches: %u", last_frame.target_switches);
+    render_string(string_buffer, x, y + (LINE_HEIGHT * 3));
+    snprintf(string_buffer, sizeof(string_buffer), "Raster blits: %u", last_frame.rasterized);
+    render_string(string_buffer, x, y + (LINE_HEIGHT * 4));
+}
@@ -0,0 +1,33 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+
+// Everything drawn with SDL_Renderer goes through these so every frame's rendering work can be counted.
+// The software renderer blits on its own and reports each sprite through draw_count_raster.
+typedef struct DrawStats
+{
+    uint32_t frames;
+    uint32_t submitted;  // Quads handed to SDL
+    uint32_t culled;  // Quads dropped before reaching SDL because they were off screen
+    uint32_t texture_binds;  // Submitted quads that used a different texture than the one before
+    uint32_t target_switches;
+    uint32_t rasterized;  // Sprites blitted by the software renderer
+} DrawStats;
+
+void begin_draw_frame(void);
+void get_draw_stats(DrawStats *last_frame, DrawStats *totals);
+void reset_draw_stats(void);
+void count_culled(uint32_t quads);
+void draw_count_raster(bool drawn);
+void draw_set_target(SDL_Texture *target);
+void draw_clear(void);
+void draw_copy(SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_Rect *dstrect);
+void draw_copy_f(SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_FRect *dstrect);
+void draw_copy_ex_f(SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_FRect *dstrect, SDL_RendererFlip flip);
+void render_draw_stats(int x, int y);
+
+#endif
@@ -0,0 +1,108 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "flowfield.h"
+#include "game.h"
+
+static const int8_t neighbor_x[4] = {0, 0, 1, -1};
+static const int8_t neighbor_y[4] = {1, -1, 0, 0};
+
+void init_flow_field(FlowField *field)
+{
+    // Impossible target so the first update always computes the field.
+    field->target_x = -1;
+    field->target_y = -1;
+    field->origin_x = 0;
+    field->origin_y = 0;
+    memset(field->distance, 0xff, sizeof(field->distance));
+}
+
+/*
+ * Breadth first search over non-SOLID tiles outward from the target, clipped to the window around it.
+ * Only runs when the target has moved to a different tile. Returns true if the field was recomputed.
+ * Mobs collide using their center point only so any 4-connected path here is one they can actually walk.
+ */
+bool update_flow_field(FlowField *field, const TileMap *tile_map, int target_x, int target_y)
+{
+    if (target_x == field->target_x && target_y == field->target_y) {
+        return false;
+    }
+    field->target_x = target_x;
+    field->target_y = target_y;
+    field->origin_x = target_x - FLOW_RADIUS;
+    field->origin_y = target_y - FLOW_RADIUS;
+    memset(field->distance, 0xff, sizeof(field->distance));
+    if (target_x < 0 || target_y < 0 || target_x >= tile_map->width || target_y >= tile_map->height) {
+        return true;
+    }
+
+    int head = 0;
+    int tail = 0;
+    int start = (FLOW_RADIUS * FLOW_SIZE) + FLOW_RADIUS;
+    field->distance[start] = 0;
+    field->queue[tail++] = start;
+    while (head < tail) {
+        int local = field->queue[head++];
+        int local_x = local % FLOW_SIZE;
+        int local_y = local / FLOW_SIZE;
+        uint16_t next_distance = field->distance[local] + 1;
+        for (int n = 0; n < 4; n++) {
+            int x = local_x + neighbor_x[n];
+            int y = local_y + neighbor_y[n];
+            if (x < 0 || y < 0 || x >= FLOW_SIZE || y >= FLOW_SIZE) {
+                continue;
+            }
+            int map_x = field->origin_x + x;
+            int map_y = field->origin_y + y;
+            if (map_x < 0 || map_y < 0 || map_x >= tile_map->width || map_y >= tile_map->height) {
+                continue;
+            }
+            int neighbor = (y * FLOW_SIZE) + x;
+            if (field->distance[neighbor] != FLOW_UNREACHABLE || (tile_map->tiles[(map_y * tile_map->width) + map_x] & SOLID)) {
+                continue;
+            }
+            field->distance[neighbor] = next_distance;
+            field->queue[tail++] = neighbor;
+        }
+    }
+    return true;
+}
+
+static uint16_t get_distance(const FlowField *field, int local_x, int local_y)
+{
+    if (local_x < 0 || local_y < 0 || local_x >= FLOW_SIZE || local_y >= FLOW_SIZE) {
+        return FLOW_UNREACHABLE;
+    }
+    return field->distance[(local_y * FLOW_SIZE) + local_x];
+}
+
+/*
+ * Picks the neighboring tile that gets closer to (or further from when fleeing) the target.
+ * Returns the tile's distance from the target or -1 if the tile is outside the field or unreachable.
+ * Direction is left at 0, 0 if no neighbor improves on the current tile.
+ */
+int sample_flow_field(const FlowField *field, int tile_x, int tile_y, bool flee, int8_t *x_direction, int8_t *y_direction)
+{
+    int local_x = tile_x - field->origin_x;
+    int local_y = tile_y - field->origin_y;
+    uint16_t distance = get_distance(field, local_x, local_y);
+    if (distance == FLOW_UNREACHABLE) {
+        return -1;
+    }
+    *x_direction = 0;
+    *y_direction = 0;
+    uint16_t best = distance;
+    for (int n = 0; n < 4; n++) {
+        uint16_t neighbor = get_distance(field, local_x + neighbor_x[n], local_y + neighbor_y[n]);
+        if (neighbor == FLOW_UNREACHABLE) {
+            continue;
+        }
+        if ((!flee && neighbor < best) || (flee && neighbor > best)) {
+            best = neighbor;
+            *x_direction = neighbor_x[n];
+            *y_direction = neighbor_y[n];
+        }
+    }
+    return distance;
+}
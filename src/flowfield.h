@@ -0,0 +1,28 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// The field only covers a square window of tiles around the target so cost doesn't depend on map size.
+#define FLOW_RADIUS 32
+#define FLOW_SIZE ((FLOW_RADIUS * 2) + 1)
+#define FLOW_UNREACHABLE 0xffff
+
+typedef struct FlowField
+{
+    int target_x;
+    int target_y;
+    int origin_x;
+    int origin_y;
+    uint16_t distance[FLOW_SIZE * FLOW_SIZE];
+    uint16_t queue[FLOW_SIZE * FLOW_SIZE];
+} FlowField;
+
+void init_flow_field(FlowField *field);
+bool update_flow_field(FlowField *field, const TileMap *tile_map, int target_x, int target_y);
+int sample_flow_field(const FlowField *field, int tile_x, int tile_y, bool flee, int8_t *x_direction, int8_t *y_direction);
+
+#endif
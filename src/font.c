@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include "SDL.h"
 
+#include "draw.h"
 #include "game.h"
 #include "font.h"
 
@@ -103,7 +104,7 @@ void render_string(const char *string, int x, int y)
         rect.y = y - glyphs[i].bearingY;
         rect.w = glyphs[i].width;
         rect.h = glyphs[i].height;
-        SDL_RenderCopy(renderer.sdl, glyphs[i].texture, NULL, &rect);
+        draw_copy(glyphs[i].texture, NULL, &rect);
         x += glyphs[i].advance;
     }
 }
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,26 +7,79 @@
 
 #include "audio.h"
 #include "assets.h"
+#include "draw.h"
+#include "flowfield.h"
 #include "font.h"
 #include "game.h"
+#include "light.h"
+#include "memory.h"
+#include "overview.h"
 #include "pcgrandom.h"
-
-#define BACKGROUND(tile) ((tile) & 127)
-#define FOREGROUND(tile) (((tile) >> 7) & 127)
+#include "raster.h"
+#include "regions.h"
+#include "snapshot.h"
+#include "tilemap.h"
 
 // Animations flip every n milliseconds.
 // Using power of 2 bitwise AND operations for performance.
 // Could switch to a modulo operation if we need better granularity but these values seem fine.
 #define MOB_ANIMATION(ticks) ((ticks) & 128)
+// Index into a MobFrame table. phase is 1 when MOB_ANIMATION is set.
+#define MOB_FRAME(facing, walking, phase) (((facing) << 2) | ((walking) << 1) | (phase))
+#define NUM_MOB_FRAMES 16
 #define WATER_ANIMATION(ticks) ((ticks) & 1024)
 
 #define MOB_SPEED 65.0f
 #define SCALE 3
 
-#define TILE_SIZE 16
+// Mobs are bucketed into square cells of 2^MOB_CELL_SHIFT tiles for render culling.
+// 8x8 tiles (128 pixels) keeps the grid small while a 300x180 camera only touches 3x3 or 4x3 cells.
+#define MOB_CELL_SHIFT 3
+#define MOB_CELL_SIZE (TILE_SIZE << MOB_CELL_SHIFT)
 
+/*
+ * World positions of sprites. Floats unless built with -DFIXED_POSITIONS=ON (the CMake option), which makes them 16.16 fixed point.
+ * Then tile lookups are shifts, movement is integer adds and replays come out bit for bit the same with any compiler or FPU settings.
+ * Positions only become floats where they're drawn. 16 integer bits limit maps to MAX_POSITION_TILES tiles across.
+ */
+#ifdef FIXED_POSITIONS
+typedef int32_t Position;
+#define POSITION_SHIFT 16
+// TILE_SIZE is 2^4.
+#define POSITION_TILE_SHIFT (POSITION_SHIFT + 4)
+#define POSITION_TILE_SIZE (TILE_SIZE << POSITION_SHIFT)
+#define FLOAT_TO_POSITION(f) ((Position)lrintf((f) * (float)(1 << POSITION_SHIFT)))
+#define POSITION_TO_FLOAT(p) ((float)(p) * (1.0f / (float)(1 << POSITION_SHIFT)))
+#define POSITION_TO_TILE(p) ((int)((p) >> POSITION_TILE_SHIFT))
+#define MAX_POSITION_TILES (INT32_MAX >> POSITION_TILE_SHIFT)
+// Returns world coordinate centered on a given tile
+#define TILE_TO_WORLD(tile) ((Position)(((tile) * TILE_SIZE) + (TILE_SIZE / 2)) << POSITION_SHIFT)
+#else
+typedef float Position;
+#define POSITION_TILE_SIZE ((float)TILE_SIZE)
+#define FLOAT_TO_POSITION(f) (f)
+#define POSITION_TO_FLOAT(p) (p)
+#define POSITION_TO_TILE(p) ((int)((p) / TILE_SIZE))
+#define MAX_POSITION_TILES INT32_MAX
 // Returns world coordinate centered on a given tile
 #define TILE_TO_WORLD(tile) (((float)(tile) * (float)TILE_SIZE) + ((float)TILE_SIZE * 0.5f))
+#endif
+
+// Seeking mobs go back to wandering once they're this many tiles from the player so they don't all pile up on top of it.
+#define SEEK_STOP_DISTANCE 2
+// Fleeing mobs only run when the player gets this close.
+#define FLEE_START_DISTANCE 6
+
+// A wandering mob turns on average once every TURN_CHANCE steer steps.
+#define TURN_CHANCE 40
+// Entries in the turn delay table. Must be enough for the thresholds to run down to 0, about 750 for a TURN_CHANCE of 40.
+#define TURN_DELAY_STEPS 1024
+// Pending turns are bucketed by steer step. Must be a power of 2. Turns further out than this wrap around and wait for another lap.
+#define TURN_WHEEL_SIZE 256
+
+// Breedings finished per tick. A count rather than a time budget so replays and batch runs come out the same on any machine.
+// Females met over the budget wait for later ticks in the order the player met them.
+#define BREED_BUDGET 4
 
 #define DOWN 0
 #define UP 1
@@ -34,8 +88,8 @@
 
 typedef struct Sprite
 {
-    float x;
-    float y;
+    Position x;
+    Position y;
     uint8_t facing;
     bool walking;
 } Sprite;
@@ -45,6 +99,8 @@ typedef struct Mob
     Sprite sprite;
     int8_t x_direction;
     int8_t y_direction;
+    bool following;  // Heading comes from the flow field rather than a random turn
+    uint32_t next_turn;  // Steer step this mob next picks a random direction on
 } Mob;
 
 typedef struct MobArray
@@ -52,8 +108,132 @@ typedef struct MobArray
     Mob *mobs;
     size_t size;
     size_t capacity;
+    uint8_t behavior;
 } MobArray;
 
+// Buckets a MobArray by position. Mob indices for cell c are indices[cell_start[c]] to indices[cell_start[c + 1] - 1].
+typedef struct MobGrid
+{
+    int width;
+    int height;
+    uint32_t *cell_start;
+    uint32_t *indices;
+    size_t capacity;
+} MobGrid;
+
+// Mob indices never change (mobs are only ever appended) so a turn is just an index into the MobArray.
+typedef struct TurnBucket
+{
+    uint32_t *indices;
+    uint32_t size;
+    uint32_t capacity;
+} TurnBucket;
+
+typedef struct TurnWheel
+{
+    TurnBucket buckets[TURN_WHEEL_SIZE];
+    TurnBucket due;
+} TurnWheel;
+
+// Virgin females the player met whose children haven't been added yet. Indices into virgin_females, oldest first.
+typedef struct BreedQueue
+{
+    uint32_t *virgins;
+    uint32_t head;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t *queued;  // Bit per virgin_females index, set while that virgin is in virgins
+    uint32_t queued_words;
+} BreedQueue;
+
+#define SNAPSHOT_VERSION 5
+
+#define SECTION_GAME 0
+#define SECTION_TILES 1
+#define SECTION_CHILDREN 2
+#define SECTION_FEMALES 3
+#define SECTION_VIRGIN_FEMALES 4
+#define SECTION_BREED_QUEUE 5
+#define NUM_SECTIONS 6
+
+// Everything that isn't a tile or a mob. mob_size guards against restoring a snapshot from a build with a different Mob layout.
+typedef struct GameSnapshot
+{
+    uint32_t mob_size;
+    uint32_t fixed_positions;  // Floats and fixed point are the same size so mob_size doesn't tell them apart
+    int32_t tile_map_width;
+    int32_t tile_map_height;
+    Sprite player;
+    float population;
+    float population_growth;
+    float mob_timer;
+    int64_t elapsed_ticks;
+    uint64_t rng_state;
+    uint64_t rng_inc;
+    uint32_t turn_step;
+} GameSnapshot;
+
+/*
+ * Everything update_game changes. There are two of these. update_game reads the front one and writes the back one,
+ * then swap_game_state makes the result the new front. That lets render_game draw the front while the next tick runs on another thread.
+ * Each tick moves every mob anyway, so writing the moved mob into the other buffer costs nothing extra over updating in place.
+ */
+typedef struct WorldState
+{
+    Sprite player;
+    MobArray females;
+    MobArray virgin_females;
+    MobArray children;
+    float population;
+    float population_growth;
+    float mob_timer;
+    // Built at the end of each update_game so render_game only walks cells on screen. Left empty without a renderer.
+    MobGrid females_grid;
+    MobGrid virgin_females_grid;
+    MobGrid children_grid;
+} WorldState;
+
+// One independent world. Nothing in here is shared so separate GameStates can be updated on separate threads.
+struct GameState
+{
+    TileMap tile_map;
+    WorldState worlds[2];
+    int front;
+    int64_t start_ticks;
+    RngState rng;
+    bool play_sounds;
+    FlowField flow_field;
+    bool has_grids;
+    uint32_t turn_step;
+    uint32_t turn_thresholds[TURN_DELAY_STEPS];  // See init_turn_thresholds
+    TurnWheel females_turns;
+    TurnWheel virgin_females_turns;
+    TurnWheel children_turns;
+    BreedQueue breed_queue;
+    SpawnZone spawn_zone;
+    bool lit;
+    LightMap light;
+    bool zoomable;  // Has a renderer that can draw the overview
+    bool has_overview;  // Built on the first zoomed frame and dropped when a snapshot replaces the map
+    Overview overview;
+};
+
+// The sprite and flip for one combination of facing, walking and animation phase.
+typedef struct MobFrame
+{
+    const SDL_Rect *srcrect;
+    SDL_RendererFlip flip;
+} MobFrame;
+
+typedef struct VisibleMob
+{
+    const Sprite *sprite;
+    const MobFrame *frames;
+} VisibleMob;
+
+// Tiles where new virgin females appear. Only the part of it the player can walk to is used.
+static const SDL_Rect spawn_area = {43, 57, 22, 14};
+
 static const SDL_Rect world_sprites[] = {
     [SPRITE_GROUND] = {0, 0, 16, 16},
     [SPRITE_GRASS] = {32, 0, 16, 16},
@@ -94,71 +274,378 @@ static const SDL_Rect virgin_female_sprites[] = {
     [SPRITE_MOB_RIGHT_1] = {80, 144, 16, 16}
 };
 
+/*
+ * Every frame render_mob can pick, built at compile time from a sprite table.
+ * Walking up or down alternates a flipped step. Left is right flipped. Standing still ignores the animation phase.
+ */
+#define MOB_FRAMES(sprites) { \
+    [MOB_FRAME(DOWN, 0, 0)] = {&(sprites)[SPRITE_MOB_DOWN_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(DOWN, 0, 1)] = {&(sprites)[SPRITE_MOB_DOWN_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(DOWN, 1, 0)] = {&(sprites)[SPRITE_MOB_DOWN_1], SDL_FLIP_NONE}, \
+    [MOB_FRAME(DOWN, 1, 1)] = {&(sprites)[SPRITE_MOB_DOWN_1], SDL_FLIP_HORIZONTAL}, \
+    [MOB_FRAME(UP, 0, 0)] = {&(sprites)[SPRITE_MOB_UP_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(UP, 0, 1)] = {&(sprites)[SPRITE_MOB_UP_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(UP, 1, 0)] = {&(sprites)[SPRITE_MOB_UP_1], SDL_FLIP_NONE}, \
+    [MOB_FRAME(UP, 1, 1)] = {&(sprites)[SPRITE_MOB_UP_1], SDL_FLIP_HORIZONTAL}, \
+    [MOB_FRAME(RIGHT, 0, 0)] = {&(sprites)[SPRITE_MOB_RIGHT_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(RIGHT, 0, 1)] = {&(sprites)[SPRITE_MOB_RIGHT_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(RIGHT, 1, 0)] = {&(sprites)[SPRITE_MOB_RIGHT_0], SDL_FLIP_NONE}, \
+    [MOB_FRAME(RIGHT, 1, 1)] = {&(sprites)[SPRITE_MOB_RIGHT_1], SDL_FLIP_NONE}, \
+    [MOB_FRAME(LEFT, 0, 0)] = {&(sprites)[SPRITE_MOB_RIGHT_0], SDL_FLIP_HORIZONTAL}, \
+    [MOB_FRAME(LEFT, 0, 1)] = {&(sprites)[SPRITE_MOB_RIGHT_0], SDL_FLIP_HORIZONTAL}, \
+    [MOB_FRAME(LEFT, 1, 0)] = {&(sprites)[SPRITE_MOB_RIGHT_0], SDL_FLIP_HORIZONTAL}, \
+    [MOB_FRAME(LEFT, 1, 1)] = {&(sprites)[SPRITE_MOB_RIGHT_1], SDL_FLIP_HORIZONTAL} \
+}
+
+static const MobFrame player_frames[NUM_MOB_FRAMES] = MOB_FRAMES(player_sprites);
+static const MobFrame female_frames[NUM_MOB_FRAMES] = MOB_FRAMES(female_sprites);
+static const MobFrame virgin_female_frames[NUM_MOB_FRAMES] = MOB_FRAMES(virgin_female_sprites);
+
 const Uint8 *keyboard;
 Renderer renderer;
 
+// Rendering only ever happens on the main thread so the sprite sheet and the visible mob list are shared by every GameState.
 static SDL_Texture *sprite_texture;
-static TileMap tile_map;
-static Sprite player = {TILE_TO_WORLD(54), TILE_TO_WORLD(23), DOWN, false};
-static MobArray females;
-static MobArray virgin_females;
-static MobArray children;
-static int64_t start_ticks;
-static float population;
-static float population_growth = 3.0f;
+static uint32_t sprite_pixels[SPRITE_SHEET_SIZE * SPRITE_SHEET_SIZE];
+static VisibleMob *visible_mobs;
+static size_t visible_mobs_size;
+static size_t visible_mobs_capacity;
 
-static void init_mob_array(MobArray *array)
+static void init_mob_array(MobArray *array, uint8_t behavior)
 {
+    array->behavior = behavior;
     array->size = 0;
     array->capacity = 16;
-    array->mobs = malloc(array->capacity * sizeof(Mob));
+    array->mobs = tracked_malloc(MEMORY_GAME, array->capacity * sizeof(Mob));
     if (array->mobs == NULL) {
         fprintf(stderr, "malloc failed\n");
         exit(EXIT_FAILURE);
     }
 }
 
-static void randomize_sprite_position(Sprite *sprite)
+static void init_mob_grid(MobGrid *grid, const TileMap *tile_map)
 {
-    uint32_t x_tile, y_tile;
-    do {
-        x_tile = pcg_ranged_random(22) + 43;
-        y_tile = pcg_ranged_random(14) + 57;
-    } while (tile_map.tiles[(y_tile * tile_map.width) + x_tile] & SOLID);
+    grid->width = ((tile_map->width * TILE_SIZE) + MOB_CELL_SIZE - 1) / MOB_CELL_SIZE;
+    grid->height = ((tile_map->height * TILE_SIZE) + MOB_CELL_SIZE - 1) / MOB_CELL_SIZE;
+    grid->cell_start = tracked_malloc(MEMORY_GAME, ((grid->width * grid->height) + 1) * sizeof(uint32_t));
+    if (grid->cell_start == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    grid->capacity = 0;
+    grid->indices = NULL;
+}
+
+static int mob_cell(const MobGrid *grid, const Sprite *sprite)
+{
+    int x = POSITION_TO_TILE(sprite->x) >> MOB_CELL_SHIFT;
+    int y = POSITION_TO_TILE(sprite->y) >> MOB_CELL_SHIFT;
+    if (x < 0) {
+        x = 0;
+    } else if (x >= grid->width) {
+        x = grid->width - 1;
+    }
+    if (y < 0) {
+        y = 0;
+    } else if (y >= grid->height) {
+        y = grid->height - 1;
+    }
+    return (y * grid->width) + x;
+}
+
+/*
+ * Counting sort of mob indices by cell. This is a single pass of integer math per mob.
+ * All the expensive per-sprite work (sprite lookup, dstrect, SDL call) only happens for mobs in cells the camera can see.
+ */
+static void build_mob_grid(MobGrid *grid, const MobArray *array)
+{
+    int num_cells = grid->width * grid->height;
+    if (grid->capacity < array->size) {
+        grid->capacity = array->capacity;
+        grid->indices = tracked_realloc(MEMORY_GAME, grid->indices, grid->capacity * sizeof(uint32_t));
+        if (grid->indices == NULL) {
+            fprintf(stderr, "realloc failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memset(grid->cell_start, 0, (num_cells + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < array->size; i++) {
+        grid->cell_start[mob_cell(grid, &array->mobs[i].sprite) + 1] += 1;
+    }
+    for (int c = 0; c < num_cells; c++) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    // Filling advances each cell's start to the next cell's start so shift everything back by one afterwards.
+    for (size_t i = 0; i < array->size; i++) {
+        int cell = mob_cell(grid, &array->mobs[i].sprite);
+        grid->indices[grid->cell_start[cell]++] = i;
+    }
+    memmove(grid->cell_start + 1, grid->cell_start, num_cells * sizeof(uint32_t));
+    grid->cell_start[0] = 0;
+}
+
+static void add_visible_mob(const Sprite *sprite, const MobFrame *frames)
+{
+    if (visible_mobs_size >= visible_mobs_capacity) {
+        visible_mobs_capacity = visible_mobs_capacity ? visible_mobs_capacity * 2 : 256;
+        visible_mobs = tracked_realloc(MEMORY_GAME, visible_mobs, visible_mobs_capacity * sizeof(VisibleMob));
+        if (visible_mobs == NULL) {
+            fprintf(stderr, "realloc failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    visible_mobs[visible_mobs_size].sprite = sprite;
+    visible_mobs[visible_mobs_size].frames = frames;
+    visible_mobs_size += 1;
+}
+
+static void init_world_grids(WorldState *world, const TileMap *tile_map)
+{
+    init_mob_grid(&world->females_grid, tile_map);
+    init_mob_grid(&world->virgin_females_grid, tile_map);
+    init_mob_grid(&world->children_grid, tile_map);
+}
+
+static void free_world_grids(WorldState *world)
+{
+    tracked_free(world->females_grid.cell_start);
+    tracked_free(world->females_grid.indices);
+    tracked_free(world->virgin_females_grid.cell_start);
+    tracked_free(world->virgin_females_grid.indices);
+    tracked_free(world->children_grid.cell_start);
+    tracked_free(world->children_grid.indices);
+}
+
+// The tick already touches every mob so this adds one more pass to it rather than one per rendered frame to render_game.
+static void build_world_grids(WorldState *world)
+{
+    build_mob_grid(&world->females_grid, &world->females);
+    build_mob_grid(&world->virgin_females_grid, &world->virgin_females);
+    build_mob_grid(&world->children_grid, &world->children);
+}
+
+// Appends every mob in the array whose sprite overlaps the camera (given as world space bounds of mob centers).
+static void cull_mobs(const MobGrid *grid, const MobArray *array, const MobFrame *frames, const SDL_FRect *camera)
+{
+    int min_x = SDL_max(0, (int)camera->x / MOB_CELL_SIZE);
+    int min_y = SDL_max(0, (int)camera->y / MOB_CELL_SIZE);
+    int max_x = SDL_min(grid->width - 1, (int)(camera->x + camera->w) / MOB_CELL_SIZE);
+    int max_y = SDL_min(grid->height - 1, (int)(camera->y + camera->h) / MOB_CELL_SIZE);
+    for (int y = min_y; y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            int cell = (y * grid->width) + x;
+            for (uint32_t i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; i++) {
+                const Sprite *sprite = &array->mobs[grid->indices[i]].sprite;
+                float sprite_x = POSITION_TO_FLOAT(sprite->x);
+                float sprite_y = POSITION_TO_FLOAT(sprite->y);
+                if (sprite_x >= camera->x && sprite_x <= camera->x + camera->w &&
+                    sprite_y >= camera->y && sprite_y <= camera->y + camera->h) {
+                    add_visible_mob(sprite, frames);
+                }
+            }
+        }
+    }
+}
+
+static void randomize_sprite_position(GameState *game, Sprite *sprite)
+{
+    int x_tile, y_tile;
+    random_spawn_tile(&game->spawn_zone, &game->rng, &x_tile, &y_tile);
     sprite->x = TILE_TO_WORLD(x_tile);
     sprite->y = TILE_TO_WORLD(y_tile);
 }
 
-static void randomize_mob_direction(Mob *mob)
+static void set_mob_direction(Mob *mob, int8_t x_direction, int8_t y_direction)
 {
-    if (pcg_ranged_random(40) == 0) {
-        mob->x_direction = (int8_t)pcg_ranged_random(3) - 1;
-        mob->y_direction = (int8_t)pcg_ranged_random(3) - 1;
-        mob->sprite.walking = false;
-        if (mob->x_direction == 1) {
-            mob->sprite.facing = RIGHT;
-            mob->sprite.walking = true;
-        }
-        if (mob->x_direction == -1) {
-            mob->sprite.facing = LEFT;
-            mob->sprite.walking = true;
+    mob->x_direction = x_direction;
+    mob->y_direction = y_direction;
+    mob->sprite.walking = false;
+    if (mob->x_direction == 1) {
+        mob->sprite.facing = RIGHT;
+        mob->sprite.walking = true;
+    }
+    if (mob->x_direction == -1) {
+        mob->sprite.facing = LEFT;
+        mob->sprite.walking = true;
+    }
+    if (mob->y_direction == -1) {
+        mob->sprite.facing = UP;
+        mob->sprite.walking = true;
+    }
+    if (mob->y_direction == 1) {
+        mob->sprite.facing = DOWN;
+        mob->sprite.walking = true;
+    }
+}
+
+static void turn_mob(RngState *rng, Mob *mob)
+{
+    int8_t x_direction = (int8_t)pcg_ranged_random(rng, 3) - 1;
+    int8_t y_direction = (int8_t)pcg_ranged_random(rng, 3) - 1;
+    set_mob_direction(mob, x_direction, y_direction);
+}
+
+/*
+ * thresholds[i] is 2^32 times the chance of going more than i + 1 steer steps without a turn, (1 - 1 / TURN_CHANCE)^(i + 1).
+ * Worked out in integers, rounding down each step, so every compiler and libm gets the same table. The last entry is 0 so any draw has a delay.
+ */
+static void init_turn_thresholds(uint32_t *thresholds)
+{
+    uint64_t threshold = (uint64_t)1 << 32;
+    for (int i = 0; i < TURN_DELAY_STEPS; i++) {
+        threshold = (threshold * (TURN_CHANCE - 1)) / TURN_CHANCE;
+        thresholds[i] = (uint32_t)threshold;
+    }
+    thresholds[TURN_DELAY_STEPS - 1] = 0;
+}
+
+/*
+ * Number of steer steps until the next turn. Same distribution as rolling a 1 in TURN_CHANCE every step and counting rolls until one hits,
+ * but costs a single random number and a binary search of the thresholds per turn instead of TURN_CHANCE rolls. Integer only.
+ */
+static uint32_t next_turn_delay(GameState *game)
+{
+    uint32_t roll = pcg_get_random(&game->rng);
+    uint32_t low = 0;
+    uint32_t high = TURN_DELAY_STEPS - 1;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (game->turn_thresholds[mid] <= roll) {
+            high = mid;
+        } else {
+            low = mid + 1;
         }
-        if (mob->y_direction == -1) {
-            mob->sprite.facing = UP;
-            mob->sprite.walking = true;
+    }
+    return low + 1;
+}
+
+static void add_turn(TurnBucket *bucket, uint32_t index)
+{
+    if (bucket->size >= bucket->capacity) {
+        bucket->capacity *= 2;
+        bucket->indices = tracked_realloc(MEMORY_GAME, bucket->indices, bucket->capacity * sizeof(uint32_t));
+        if (bucket->indices == NULL) {
+            fprintf(stderr, "realloc failed\n");
+            exit(EXIT_FAILURE);
         }
-        if (mob->y_direction == 1) {
-            mob->sprite.facing = DOWN;
-            mob->sprite.walking = true;
+    }
+    bucket->indices[bucket->size++] = index;
+}
+
+static void schedule_turn(TurnWheel *wheel, const Mob *mob, uint32_t index)
+{
+    add_turn(&wheel->buckets[mob->next_turn & (TURN_WHEEL_SIZE - 1)], index);
+}
+
+static void init_turn_bucket(TurnBucket *bucket)
+{
+    bucket->size = 0;
+    bucket->capacity = 16;
+    bucket->indices = tracked_malloc(MEMORY_GAME, bucket->capacity * sizeof(uint32_t));
+    if (bucket->indices == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Every bucket gets allocated up front. Otherwise buckets would keep getting allocated one at a time as turns first land in them.
+static void init_turn_wheel(TurnWheel *wheel)
+{
+    for (int i = 0; i < TURN_WHEEL_SIZE; i++) {
+        init_turn_bucket(&wheel->buckets[i]);
+    }
+    init_turn_bucket(&wheel->due);
+}
+
+static void clear_turn_wheel(TurnWheel *wheel)
+{
+    for (int i = 0; i < TURN_WHEEL_SIZE; i++) {
+        wheel->buckets[i].size = 0;
+    }
+}
+
+static void free_turn_wheel(TurnWheel *wheel)
+{
+    for (int i = 0; i < TURN_WHEEL_SIZE; i++) {
+        tracked_free(wheel->buckets[i].indices);
+    }
+    tracked_free(wheel->due.indices);
+}
+
+/*
+ * O(1) per mob regardless of how many mobs there are. All the path finding was done once in update_flow_field.
+ * A mob that stops following (arrived, or the player is out of range) turns randomly right away instead of keeping the flow field heading.
+ * Returns true if the mob's direction was picked here.
+ */
+static bool follow_flow_field(GameState *game, Mob *mob, uint8_t behavior)
+{
+    int8_t x_direction, y_direction;
+    int distance = sample_flow_field(&game->flow_field, POSITION_TO_TILE(mob->sprite.x), POSITION_TO_TILE(mob->sprite.y), behavior == MOB_FLEE, &x_direction, &y_direction);
+    if ((behavior == MOB_SEEK && distance > SEEK_STOP_DISTANCE) || (behavior == MOB_FLEE && distance >= 0 && distance < FLEE_START_DISTANCE)) {
+        set_mob_direction(mob, x_direction, y_direction);
+        mob->following = true;
+        return true;
+    }
+    if (mob->following) {
+        mob->following = false;
+        turn_mob(&game->rng, mob);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Turns every mob whose next_turn is the current steer step and schedules its next one. Only touches those mobs (about 1 in TURN_CHANCE).
+ * Mobs following the flow field keep their heading but still reschedule. Rolls are independent so skipping one changes nothing.
+ */
+static void run_turns(GameState *game, TurnWheel *wheel, MobArray *array)
+{
+    TurnBucket *bucket = &wheel->buckets[game->turn_step & (TURN_WHEEL_SIZE - 1)];
+    // Rescheduling can land back in this bucket so work from a copy.
+    TurnBucket due = *bucket;
+    *bucket = wheel->due;
+    bucket->size = 0;
+    for (uint32_t i = 0; i < due.size; i++) {
+        Mob *mob = &array->mobs[due.indices[i]];
+        if (mob->next_turn == game->turn_step) {
+            if (array->behavior == MOB_WANDER || !follow_flow_field(game, mob, array->behavior)) {
+                turn_mob(&game->rng, mob);
+            }
+            mob->next_turn = game->turn_step + next_turn_delay(game);
         }
+        schedule_turn(wheel, mob, due.indices[i]);
     }
+    wheel->due = due;
+}
+
+static void check_position_range(int width, int height)
+{
+    if (width > MAX_POSITION_TILES || height > MAX_POSITION_TILES) {
+        fprintf(stderr, "Maps can't be more than %d tiles across in this build\n", (int)MAX_POSITION_TILES);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void init_game_spawn_zone(GameState *game)
+{
+    // The zone is collected from the region lists, which tile edits leave stale.
+    if (game->tile_map.region_lists_stale) {
+        build_regions(&game->tile_map);
+    }
+    const Sprite *player = &game->worlds[game->front].player;
+    uint32_t region = nearest_region(&game->tile_map, POSITION_TO_TILE(player->x), POSITION_TO_TILE(player->y));
+    if (region == REGION_NONE) {
+        fprintf(stderr, "Level has no walkable tiles\n");
+        exit(EXIT_FAILURE);
+    }
+    init_spawn_zone(&game->spawn_zone, &game->tile_map, region, &spawn_area);
 }
 
 static void add_mob(Mob *mob, MobArray *array)
 {
     if (array->size >= array->capacity) {
         array->capacity *= 2;
-        array->mobs = realloc(array->mobs, array->capacity * sizeof(Mob));
+        array->mobs = tracked_realloc(MEMORY_GAME, array->mobs, array->capacity * sizeof(Mob));
         if (array->mobs == NULL) {
             fprintf(stderr, "realloc failed\n");
             exit(EXIT_FAILURE);
@@ -168,188 +655,694 @@ static void add_mob(Mob *mob, MobArray *array)
     array->size += 1;
 }
 
-void init_game(int64_t ticks)
+GameState *init_game(int64_t ticks, const char *level, const RngState *rng, uint8_t children_behavior, bool play_sounds)
 {
-    start_ticks = ticks;
-    sprite_texture = load_sprites("res/sprites.png");
-    load_level(&tile_map, "res/levels/ocean.png");
-    init_mob_array(&females);
-    init_mob_array(&virgin_females);
-    init_mob_array(&children);
+    GameState *game = tracked_calloc(MEMORY_GAME, 1, sizeof(GameState));
+    if (game == NULL) {
+        fprintf(stderr, "calloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    game->start_ticks = ticks;
+    game->rng = *rng;
+    game->play_sounds = play_sounds;
+    init_turn_thresholds(game->turn_thresholds);
+    // Headless replays run without a renderer. Every world shares one sprite sheet.
+    if (renderer.sdl && sprite_texture == NULL) {
+        // The overview pyramid is built from the sheet pixels so they're kept for both renderers.
+        sprite_texture = load_sprites("res/sprites.png", sprite_pixels);
+        if (renderer.software) {
+            init_raster(sprite_pixels, SPRITE_SHEET_SIZE);
+        }
+    }
+    load_level(&game->tile_map, level, &game->rng);
+    check_position_range(game->tile_map.width, game->tile_map.height);
+    // Everything wanders unless the children were told to seek or flee the player.
+    for (int i = 0; i < 2; i++) {
+        init_mob_array(&game->worlds[i].females, MOB_WANDER);
+        init_mob_array(&game->worlds[i].virgin_females, MOB_WANDER);
+        init_mob_array(&game->worlds[i].children, children_behavior);
+    }
+    game->front = 0;
+    WorldState *world = &game->worlds[game->front];
+    world->player = (Sprite){TILE_TO_WORLD(54), TILE_TO_WORLD(23), DOWN, false};
+    world->population = 0.0f;
+    world->population_growth = 3.0f;
+    world->mob_timer = 0.0f;
+    init_game_spawn_zone(game);
+    init_flow_field(&game->flow_field);
+    init_turn_wheel(&game->females_turns);
+    init_turn_wheel(&game->virgin_females_turns);
+    init_turn_wheel(&game->children_turns);
+    init_world_grids(&game->worlds[0], &game->tile_map);
+    init_world_grids(&game->worlds[1], &game->tile_map);
     Mob first_female = {
         {TILE_TO_WORLD(66), TILE_TO_WORLD(26), DOWN, false},
-        0, 0
+        0, 0, false, next_turn_delay(game)
     };
-    add_mob(&first_female, &virgin_females);
+    schedule_turn(&game->virgin_females_turns, &first_female, 0);
+    add_mob(&first_female, &world->virgin_females);
+    // Grids are only for culling so headless runs skip them.
+    game->has_grids = renderer.sdl != NULL;
+    if (game->has_grids) {
+        build_world_grids(world);
+    }
+    // Light maps are textures so there's only lighting when there's something to draw them with.
+    if (renderer.sdl && renderer.night && !renderer.software) {
+        init_light_map(&game->light, &game->tile_map);
+        game->lit = true;
+    }
+    // Most sessions never zoom out so the pyramid waits until someone does.
+    game->zoomable = renderer.sdl && !renderer.software;
+    return game;
 }
 
-static void mob_move(Mob *mob, float mob_speed)
+void free_game(GameState *game)
 {
-    float x = mob->sprite.x + (mob_speed * mob->x_direction);
-    float y = mob->sprite.y + (mob_speed * mob->y_direction);
+    for (int i = 0; i < 2; i++) {
+        tracked_free(game->worlds[i].females.mobs);
+        tracked_free(game->worlds[i].virgin_females.mobs);
+        tracked_free(game->worlds[i].children.mobs);
+        free_world_grids(&game->worlds[i]);
+    }
+    free_turn_wheel(&game->females_turns);
+    free_turn_wheel(&game->virgin_females_turns);
+    free_turn_wheel(&game->children_turns);
+    tracked_free(game->breed_queue.virgins);
+    tracked_free(game->breed_queue.queued);
+    if (game->lit) {
+        free_light_map(&game->light);
+    }
+    if (game->has_overview) {
+        free_overview(&game->overview);
+    }
+    free_spawn_zone(&game->spawn_zone);
+    free_regions(&game->tile_map);
+    tracked_free(game->tile_map.tiles);
+    tracked_free(game);
+}
 
-    int cur_tile_x = mob->sprite.x / TILE_SIZE;
-    int cur_tile_y = mob->sprite.y / TILE_SIZE;
-    int new_tile_x = x / TILE_SIZE;
-    int new_tile_y = y / TILE_SIZE;
-    if (!(tile_map.tiles[(cur_tile_y * tile_map.width) + new_tile_x] & SOLID)) {
+static void mob_move(const TileMap *tile_map, Mob *mob, Position mob_speed)
+{
+    Position x = mob->sprite.x + (mob_speed * mob->x_direction);
+    Position y = mob->sprite.y + (mob_speed * mob->y_direction);
+
+    int cur_tile_x = POSITION_TO_TILE(mob->sprite.x);
+    int cur_tile_y = POSITION_TO_TILE(mob->sprite.y);
+    int new_tile_x = POSITION_TO_TILE(x);
+    int new_tile_y = POSITION_TO_TILE(y);
+    if (!(tile_map->tiles[(cur_tile_y * tile_map->width) + new_tile_x] & SOLID)) {
         mob->sprite.x = x;
     }
-    if (!(tile_map.tiles[(new_tile_y * tile_map.width) + cur_tile_x] & SOLID)) {
+    if (!(tile_map->tiles[(new_tile_y * tile_map->width) + cur_tile_x] & SOLID)) {
         mob->sprite.y = y;
     }
 }
 
-void update_game(float delta)
+uint8_t read_keyboard(void)
 {
-    static float mob_timer = 0.0f;
-    mob_timer += delta;
-    population += (population_growth * delta);
-    float mob_speed = delta * MOB_SPEED;
-    float x = player.x;
-    float y = player.y;
-    player.walking = false;
+    uint8_t input = 0;
     if (keyboard[SDL_SCANCODE_RIGHT] || keyboard[SDL_SCANCODE_D]) {
-        x += mob_speed;
-        player.facing = RIGHT;
-        player.walking = true;
+        input |= INPUT_RIGHT;
     }
     if (keyboard[SDL_SCANCODE_LEFT] || keyboard[SDL_SCANCODE_A]) {
-        x -= mob_speed;
-        player.facing = LEFT;
-        player.walking = true;
+        input |= INPUT_LEFT;
     }
     if (keyboard[SDL_SCANCODE_UP] || keyboard[SDL_SCANCODE_W]) {
-        y -= mob_speed;
-        player.facing = UP;
-        player.walking = true;
+        input |= INPUT_UP;
     }
     if (keyboard[SDL_SCANCODE_DOWN] || keyboard[SDL_SCANCODE_S]) {
-        y += mob_speed;
-        player.facing = DOWN;
-        player.walking = true;
+        input |= INPUT_DOWN;
     }
+    return input;
+}
 
-    int cur_tile_x = player.x / TILE_SIZE;
-    int cur_tile_y = player.y / TILE_SIZE;
-    int new_tile_x = x / TILE_SIZE;
-    int new_tile_y = y / TILE_SIZE;
-    if (!(tile_map.tiles[(cur_tile_y * tile_map.width) + new_tile_x] & SOLID)) {
-        player.x = x;
+static void ensure_mob_capacity(MobArray *array, size_t size)
+{
+    if (size > array->capacity) {
+        while (array->capacity < size) {
+            array->capacity *= 2;
+        }
+        array->mobs = tracked_realloc(MEMORY_GAME, array->mobs, array->capacity * sizeof(Mob));
+        if (array->mobs == NULL) {
+            fprintf(stderr, "realloc failed\n");
+            exit(EXIT_FAILURE);
+        }
     }
-    if (!(tile_map.tiles[(new_tile_y * tile_map.width) + cur_tile_x] & SOLID)) {
-        player.y = y;
+}
+
+// Writes every mob of prev, steered (if it's time) and moved, into next. Random turns are applied afterwards by run_turns.
+static void advance_mob_array(GameState *game, MobArray *next, const MobArray *prev, bool steer, Position mob_speed)
+{
+    ensure_mob_capacity(next, prev->size);
+    next->size = prev->size;
+    bool follow = steer && prev->behavior != MOB_WANDER;
+    for (size_t i = 0; i < prev->size; i++) {
+        Mob mob = prev->mobs[i];
+        if (follow) {
+            follow_flow_field(game, &mob, prev->behavior);
+        }
+        mob_move(&game->tile_map, &mob, mob_speed);
+        next->mobs[i] = mob;
     }
+}
+
+static bool is_breed_queued(const BreedQueue *queue, uint32_t virgin)
+{
+    return virgin / 32 < queue->queued_words && (queue->queued[virgin / 32] & (1u << (virgin % 32)));
+}
 
-    if (mob_timer >= 0.02f) {
-        for (size_t i = 0; i < children.size; i++) {
-            randomize_mob_direction(children.mobs + i);
+static void queue_breed(BreedQueue *queue, uint32_t virgin)
+{
+    if (queue->size >= queue->capacity) {
+        // Reuse the space in front of head before growing.
+        if (queue->head > 0) {
+            memmove(queue->virgins, queue->virgins + queue->head, (queue->size - queue->head) * sizeof(uint32_t));
+            queue->size -= queue->head;
+            queue->head = 0;
+        } else {
+            queue->capacity = queue->capacity ? queue->capacity * 2 : 16;
+            queue->virgins = tracked_realloc(MEMORY_GAME, queue->virgins, queue->capacity * sizeof(uint32_t));
+            if (queue->virgins == NULL) {
+                fprintf(stderr, "realloc failed\n");
+                exit(EXIT_FAILURE);
+            }
         }
-        for (size_t i = 0; i < females.size; i++) {
-            randomize_mob_direction(females.mobs + i);
+    }
+    queue->virgins[queue->size++] = virgin;
+    if (virgin / 32 >= queue->queued_words) {
+        uint32_t words = SDL_max(virgin / 32 + 1, queue->queued_words * 2);
+        queue->queued = tracked_realloc(MEMORY_GAME, queue->queued, words * sizeof(uint32_t));
+        if (queue->queued == NULL) {
+            fprintf(stderr, "realloc failed\n");
+            exit(EXIT_FAILURE);
         }
-        for (size_t i = 0; i < virgin_females.size; i++) {
-            randomize_mob_direction(virgin_females.mobs + i);
+        memset(queue->queued + queue->queued_words, 0, (words - queue->queued_words) * sizeof(uint32_t));
+        queue->queued_words = words;
+    }
+    queue->queued[virgin / 32] |= 1u << (virgin % 32);
+}
+
+// Children appear where the virgin is, it joins the females and a new virgin takes its place.
+static void finish_breeding(GameState *game, WorldState *next, uint32_t virgin)
+{
+    MobArray *children = &next->children;
+    MobArray *females = &next->females;
+    MobArray *virgin_females = &next->virgin_females;
+    game->breed_queue.queued[virgin / 32] &= ~(1u << (virgin % 32));
+    uint32_t num_children = pcg_ranged_random(&game->rng, 4) + 1;
+    for (uint32_t c = 0; c < num_children; c++) {
+        Mob child = {
+            {virgin_females->mobs[virgin].sprite.x, virgin_females->mobs[virgin].sprite.y, DOWN, false},
+            0, 0, false, game->turn_step + next_turn_delay(game)
+        };
+        if (pcg_ranged_random(&game->rng, TURN_CHANCE) == 0) {
+            turn_mob(&game->rng, &child);
         }
-        mob_timer = 0.0f;
-    }
-
-    for (size_t i = 0; i < children.size; i++) {
-        mob_move(children.mobs + i, mob_speed);
-    }
-    for (size_t i = 0; i < females.size; i++) {
-        mob_move(females.mobs + i, mob_speed);
-    }
-    for (size_t i = 0; i < virgin_females.size; i++) {
-        mob_move(virgin_females.mobs + i, mob_speed);
-    }
-
-    SDL_FRect player_rect;
-    player_rect.x = player.x - (TILE_SIZE * 0.5f);
-    player_rect.y = player.y - (TILE_SIZE * 0.5f);
-    player_rect.w = TILE_SIZE;
-    player_rect.h = TILE_SIZE;
-    for (size_t i = 0; i < virgin_females.size; i++) {
-        SDL_FRect female_rect;
-        female_rect.x = virgin_females.mobs[i].sprite.x - (TILE_SIZE * 0.5f);
-        female_rect.y = virgin_females.mobs[i].sprite.y - (TILE_SIZE * 0.5f);
-        female_rect.w = TILE_SIZE;
-        female_rect.h = TILE_SIZE;
-        if (SDL_HasIntersectionF(&player_rect, &female_rect)) {
-            population_growth += (population_growth * 0.25f);
-            play_sound(&breed);
-            uint32_t num_children = pcg_ranged_random(4) + 1;
-            for (uint32_t c = 0; c < num_children; c++) {
-                Mob child = {
-                    {virgin_females.mobs[i].sprite.x, virgin_females.mobs[i].sprite.y, DOWN, false},
-                    0, 0
-                };
-                randomize_mob_direction(&child);
-                add_mob(&child, &children);
-            }
-            add_mob(virgin_females.mobs + i, &females);
-            randomize_sprite_position(&virgin_females.mobs[i].sprite);
-            if (pcg_get_random() & 1) {
-                Mob virgin;
-                memset(&virgin, 0, sizeof(Mob));
-                randomize_sprite_position(&virgin.sprite);
-                add_mob(&virgin, &virgin_females);                
+        schedule_turn(&game->children_turns, &child, children->size);
+        add_mob(&child, children);
+    }
+    // The new female keeps the virgin's pending turn.
+    schedule_turn(&game->females_turns, virgin_females->mobs + virgin, females->size);
+    add_mob(virgin_females->mobs + virgin, females);
+    randomize_sprite_position(game, &virgin_females->mobs[virgin].sprite);
+    if (pcg_get_random(&game->rng) & 1) {
+        Mob mob;
+        memset(&mob, 0, sizeof(Mob));
+        randomize_sprite_position(game, &mob.sprite);
+        mob.next_turn = game->turn_step + next_turn_delay(game);
+        schedule_turn(&game->virgin_females_turns, &mob, virgin_females->size);
+        add_mob(&mob, virgin_females);
+    }
+}
+
+// Finishes up to BREED_BUDGET queued breedings, oldest first, so meeting a crowd doesn't land all the new mobs on one tick.
+static void run_breed_queue(GameState *game, WorldState *next)
+{
+    BreedQueue *queue = &game->breed_queue;
+    for (int i = 0; i < BREED_BUDGET && queue->head < queue->size; i++) {
+        finish_breeding(game, next, queue->virgins[queue->head++]);
+    }
+    if (queue->head == queue->size) {
+        queue->head = 0;
+        queue->size = 0;
+    }
+}
+
+// Whether TILE_SIZE boxes centered on the two sprites overlap.
+static bool sprites_touch(const Sprite *a, const Sprite *b)
+{
+    Position dx = a->x > b->x ? a->x - b->x : b->x - a->x;
+    Position dy = a->y > b->y ? a->y - b->y : b->y - a->y;
+    return dx < POSITION_TILE_SIZE && dy < POSITION_TILE_SIZE;
+}
+
+void update_game(GameState *game, float delta, uint8_t input)
+{
+    const TileMap *tile_map = &game->tile_map;
+    const WorldState *prev = &game->worlds[game->front];
+    WorldState *next = &game->worlds[game->front ^ 1];
+    next->mob_timer = prev->mob_timer + delta;
+    next->population = prev->population + (prev->population_growth * delta);
+    next->population_growth = prev->population_growth;
+    // The only float math in a tick. Everything after moves by whole steps of this.
+    Position mob_speed = FLOAT_TO_POSITION(delta * MOB_SPEED);
+    Sprite *player = &next->player;
+    *player = prev->player;
+    Position x = player->x;
+    Position y = player->y;
+    player->walking = false;
+    if (input & INPUT_RIGHT) {
+        x += mob_speed;
+        player->facing = RIGHT;
+        player->walking = true;
+    }
+    if (input & INPUT_LEFT) {
+        x -= mob_speed;
+        player->facing = LEFT;
+        player->walking = true;
+    }
+    if (input & INPUT_UP) {
+        y -= mob_speed;
+        player->facing = UP;
+        player->walking = true;
+    }
+    if (input & INPUT_DOWN) {
+        y += mob_speed;
+        player->facing = DOWN;
+        player->walking = true;
+    }
+
+    int cur_tile_x = POSITION_TO_TILE(player->x);
+    int cur_tile_y = POSITION_TO_TILE(player->y);
+    int new_tile_x = POSITION_TO_TILE(x);
+    int new_tile_y = POSITION_TO_TILE(y);
+    if (!(tile_map->tiles[(cur_tile_y * tile_map->width) + new_tile_x] & SOLID)) {
+        player->x = x;
+    }
+    if (!(tile_map->tiles[(new_tile_y * tile_map->width) + cur_tile_x] & SOLID)) {
+        player->y = y;
+    }
+
+    update_flow_field(&game->flow_field, tile_map, POSITION_TO_TILE(player->x), POSITION_TO_TILE(player->y));
+
+    bool steer = next->mob_timer >= 0.02f;
+    if (steer) {
+        next->mob_timer = 0.0f;
+    }
+    advance_mob_array(game, &next->children, &prev->children, steer, mob_speed);
+    advance_mob_array(game, &next->females, &prev->females, steer, mob_speed);
+    advance_mob_array(game, &next->virgin_females, &prev->virgin_females, steer, mob_speed);
+    if (steer) {
+        game->turn_step += 1;
+        run_turns(game, &game->children_turns, &next->children);
+        run_turns(game, &game->females_turns, &next->females);
+        run_turns(game, &game->virgin_females_turns, &next->virgin_females);
+    }
+
+    const MobArray *virgin_females = &next->virgin_females;
+    for (size_t i = 0; i < virgin_females->size; i++) {
+        // A queued virgin keeps wandering until run_breed_queue gets to it, so it can touch the player again on later ticks and mustn't breed twice.
+        if (sprites_touch(player, &virgin_females->mobs[i].sprite) && !is_breed_queued(&game->breed_queue, i)) {
+            next->population_growth += (next->population_growth * 0.25f);
+            if (game->play_sounds) {
+                play_sound(&breed);
             }
+            queue_breed(&game->breed_queue, i);
         }
     }
+    run_breed_queue(game, next);
+    if (game->has_grids) {
+        build_world_grids(next);
+    }
 }
 
-static void render_mob(Sprite *sprite, const SDL_Rect *srcrect, int64_t ticks)
+// Publishes the result of the last update_game. Must not be called while update_game or render_game is running.
+void swap_game_state(GameState *game)
 {
-    SDL_RendererFlip flip = SDL_FLIP_NONE;
-    switch (sprite->facing) {
-        case DOWN:
-            if (sprite->walking) {
-                srcrect += SPRITE_MOB_DOWN_1;
-                if (MOB_ANIMATION(ticks)) {
-                    flip = SDL_FLIP_HORIZONTAL;
-                }
-            } else {
-                srcrect += SPRITE_MOB_DOWN_0;
-            }
-            break;
+    game->front ^= 1;
+}
+
+/*
+ * Changes one tile at runtime. Collision, regions, the spawn zone and the flow field are patched right away.
+ * Light and the overview follow on the next render_game from the dirty rects. Must not be called while update_game or render_game is running.
+ */
+void set_game_tile(GameState *game, int x, int y, uint16_t tile)
+{
+    SDL_Rect changed;
+    if (!set_tile(&game->tile_map, x, y, tile, &changed)) {
+        return;
+    }
+    bool rebuilt = update_regions(&game->tile_map, &changed);
+#ifdef CHECK_REGIONS
+    check_regions(&game->tile_map);
+#endif
+    if (!rebuilt) {
+        update_spawn_zone(&game->spawn_zone, &game->tile_map, &changed);
+    }
+    // A zone that ran out falls back to the whole region so it's collected again like after a rebuild.
+    if (rebuilt || game->spawn_zone.size == 0) {
+        init_game_spawn_zone(game);
+    }
+    // The field is only worked out again when the player moves to another tile so a wall changing inside it has to force that.
+    SDL_Rect window = {game->flow_field.origin_x, game->flow_field.origin_y, FLOW_SIZE, FLOW_SIZE};
+    if (SDL_HasIntersection(&changed, &window)) {
+        init_flow_field(&game->flow_field);
+    }
+}
+
+// Debug edit for trying out set_game_tile. The tile the player faces becomes rock, or ground if it was already SOLID.
+void toggle_facing_tile(GameState *game)
+{
+    const Sprite *player = &game->worlds[game->front].player;
+    int x = POSITION_TO_TILE(player->x);
+    int y = POSITION_TO_TILE(player->y);
+    switch (player->facing) {
         case UP:
-            if (sprite->walking) {
-                srcrect += SPRITE_MOB_UP_1;
-                if (MOB_ANIMATION(ticks)) {
-                    flip = SDL_FLIP_HORIZONTAL;
-                }
-            } else {
-                srcrect += SPRITE_MOB_UP_0;
-            }
+            y--;
             break;
-        case RIGHT:
-            if (sprite->walking && MOB_ANIMATION(ticks)) {
-                srcrect += SPRITE_MOB_RIGHT_1;
-            } else {
-                srcrect += SPRITE_MOB_RIGHT_0;
-            }
+        case DOWN:
+            y++;
             break;
         case LEFT:
-            if (sprite->walking && MOB_ANIMATION(ticks)) {
-                srcrect += SPRITE_MOB_RIGHT_1;
-            } else {
-                srcrect += SPRITE_MOB_RIGHT_0;
-            }
-            flip = SDL_FLIP_HORIZONTAL;
+            x--;
+            break;
+        case RIGHT:
+            x++;
             break;
     }
+    if (x < 0 || y < 0 || x >= game->tile_map.width || y >= game->tile_map.height) {
+        return;
+    }
+    bool solid = game->tile_map.tiles[(y * game->tile_map.width) + x] & SOLID;
+    set_game_tile(game, x, y, solid ? TILE_GROUND : TILE_ROCK);
+}
+
+void save_game(const GameState *game, const char *filename, int64_t ticks)
+{
+    const TileMap *tile_map = &game->tile_map;
+    const WorldState *world = &game->worlds[game->front];
+    GameSnapshot header;
+    memset(&header, 0, sizeof(GameSnapshot));
+    header.mob_size = sizeof(Mob);
+#ifdef FIXED_POSITIONS
+    header.fixed_positions = 1;
+#endif
+    header.tile_map_width = tile_map->width;
+    header.tile_map_height = tile_map->height;
+    header.player = world->player;
+    header.population = world->population;
+    header.population_growth = world->population_growth;
+    header.mob_timer = world->mob_timer;
+    header.elapsed_ticks = ticks - game->start_ticks;
+    header.rng_state = game->rng.state;
+    header.rng_inc = game->rng.inc;
+    header.turn_step = game->turn_step;
+
+    SnapshotSection sections[NUM_SECTIONS];
+    sections[SECTION_GAME].data = &header;
+    sections[SECTION_GAME].size = sizeof(GameSnapshot);
+    sections[SECTION_TILES].data = tile_map->tiles;
+    sections[SECTION_TILES].size = (uint64_t)tile_map->width * tile_map->height * sizeof(uint16_t);
+    sections[SECTION_CHILDREN].data = world->children.mobs;
+    sections[SECTION_CHILDREN].size = world->children.size * sizeof(Mob);
+    sections[SECTION_FEMALES].data = world->females.mobs;
+    sections[SECTION_FEMALES].size = world->females.size * sizeof(Mob);
+    sections[SECTION_VIRGIN_FEMALES].data = world->virgin_females.mobs;
+    sections[SECTION_VIRGIN_FEMALES].size = world->virgin_females.size * sizeof(Mob);
+    sections[SECTION_BREED_QUEUE].data = game->breed_queue.virgins + game->breed_queue.head;
+    sections[SECTION_BREED_QUEUE].size = (game->breed_queue.size - game->breed_queue.head) * sizeof(uint32_t);
+    write_snapshot(filename, SNAPSHOT_VERSION, sections, NUM_SECTIONS);
+}
+
+// Bools from a file can hold any byte so they're checked as bytes before anything reads them as bools.
+static bool valid_bool(const bool *value)
+{
+    uint8_t byte;
+    memcpy(&byte, value, sizeof(byte));
+    return byte <= 1;
+}
+
+// False for positions off the map (including NaN) and for facings or walking flags MOB_FRAME has no frame for.
+static bool valid_sprite(const Sprite *sprite, int width, int height)
+{
+    return sprite->x >= 0 && sprite->y >= 0 && sprite->x < POSITION_TILE_SIZE * width && sprite->y < POSITION_TILE_SIZE * height &&
+        sprite->facing <= LEFT && valid_bool(&sprite->walking);
+}
+
+// Mobs also need directions mob_move can step with and a turn the wheel will reach, at most TURN_DELAY_STEPS after turn_step.
+static bool valid_mob_section(const SnapshotSection *section, int width, int height, uint32_t turn_step)
+{
+    if (section->size % sizeof(Mob) != 0) {
+        return false;
+    }
+    for (uint64_t i = 0; i < section->size / sizeof(Mob); i++) {
+        Mob mob;
+        memcpy(&mob, (const uint8_t *)section->data + (i * sizeof(Mob)), sizeof(Mob));
+        uint32_t turn_in = mob.next_turn - turn_step;
+        if (!valid_sprite(&mob.sprite, width, height) || mob.x_direction < -1 || mob.x_direction > 1 || mob.y_direction < -1 || mob.y_direction > 1 ||
+            !valid_bool(&mob.following) || turn_in == 0 || turn_in > TURN_DELAY_STEPS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void restore_mob_array(MobArray *array, TurnWheel *wheel, const SnapshotSection *section)
+{
+    size_t size = section->size / sizeof(Mob);
+    ensure_mob_capacity(array, size);
+    memcpy(array->mobs, section->data, section->size);
+    array->size = size;
+    clear_turn_wheel(wheel);
+    for (size_t i = 0; i < size; i++) {
+        schedule_turn(wheel, &array->mobs[i], i);
+    }
+}
+
+void load_game(GameState *game, const char *filename, int64_t ticks)
+{
+    TileMap *tile_map = &game->tile_map;
+    Snapshot snapshot;
+    open_snapshot(&snapshot, filename, SNAPSHOT_VERSION);
+    if (snapshot.num_sections != NUM_SECTIONS || snapshot.sections[SECTION_GAME].size != sizeof(GameSnapshot)) {
+        fprintf(stderr, "%s: Unexpected snapshot layout\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    GameSnapshot header;
+    memcpy(&header, snapshot.sections[SECTION_GAME].data, sizeof(GameSnapshot));
+    uint64_t tiles_size = (uint64_t)header.tile_map_width * header.tile_map_height * sizeof(uint16_t);
+#ifdef FIXED_POSITIONS
+    bool fixed_positions = true;
+#else
+    bool fixed_positions = false;
+#endif
+    if (header.mob_size != sizeof(Mob) || header.fixed_positions != fixed_positions || header.tile_map_width <= 0 || header.tile_map_height <= 0 || snapshot.sections[SECTION_TILES].size != tiles_size) {
+        fprintf(stderr, "%s: Snapshot was written by an incompatible build\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    check_position_range(header.tile_map_width, header.tile_map_height);
+    // Checked before anything is restored so a damaged snapshot can't overrun an array, leave a mob off the map or strand it in the turn wheel.
+    const SnapshotSection *queued = &snapshot.sections[SECTION_BREED_QUEUE];
+    uint64_t num_virgins = snapshot.sections[SECTION_VIRGIN_FEMALES].size / sizeof(Mob);
+    bool valid = valid_sprite(&header.player, header.tile_map_width, header.tile_map_height) && queued->size % sizeof(uint32_t) == 0;
+    for (int section = SECTION_CHILDREN; section <= SECTION_VIRGIN_FEMALES; section++) {
+        valid = valid && valid_mob_section(&snapshot.sections[section], header.tile_map_width, header.tile_map_height, header.turn_step);
+    }
+    for (uint64_t i = 0; valid && i < queued->size / sizeof(uint32_t); i++) {
+        uint32_t virgin;
+        memcpy(&virgin, (const uint8_t *)queued->data + (i * sizeof(uint32_t)), sizeof(uint32_t));
+        valid = virgin < num_virgins;
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: Snapshot is damaged\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    if (header.tile_map_width != tile_map->width || header.tile_map_height != tile_map->height) {
+        tile_map->width = header.tile_map_width;
+        tile_map->height = header.tile_map_height;
+        tile_map->tiles = tracked_realloc(MEMORY_GAME, tile_map->tiles, tiles_size);
+        if (tile_map->tiles == NULL) {
+            fprintf(stderr, "realloc failed\n");
+            exit(EXIT_FAILURE);
+        }
+        // Grid dimensions follow the tile map.
+        for (int i = 0; i < 2; i++) {
+            free_world_grids(&game->worlds[i]);
+            init_world_grids(&game->worlds[i], tile_map);
+        }
+    }
+    memcpy(tile_map->tiles, snapshot.sections[SECTION_TILES].data, tiles_size);
+    // Everything derived from the tiles is rebuilt below.
+    tile_map->dirty.count = 0;
+    init_flow_field(&game->flow_field);
+    WorldState *world = &game->worlds[game->front];
+    restore_mob_array(&world->children, &game->children_turns, &snapshot.sections[SECTION_CHILDREN]);
+    restore_mob_array(&world->females, &game->females_turns, &snapshot.sections[SECTION_FEMALES]);
+    restore_mob_array(&world->virgin_females, &game->virgin_females_turns, &snapshot.sections[SECTION_VIRGIN_FEMALES]);
+    world->player = header.player;
+    world->population = header.population;
+    world->population_growth = header.population_growth;
+    world->mob_timer = header.mob_timer;
+    game->start_ticks = ticks - header.elapsed_ticks;
+    game->rng.state = header.rng_state;
+    game->rng.inc = header.rng_inc | 1;
+    game->turn_step = header.turn_step;
+    BreedQueue *queue = &game->breed_queue;
+    queue->head = 0;
+    queue->size = 0;
+    if (queue->queued) {
+        memset(queue->queued, 0, queue->queued_words * sizeof(uint32_t));
+    }
+    for (uint64_t i = 0; i < queued->size / sizeof(uint32_t); i++) {
+        uint32_t virgin;
+        memcpy(&virgin, (const uint8_t *)queued->data + (i * sizeof(uint32_t)), sizeof(uint32_t));
+        queue_breed(queue, virgin);
+    }
+    build_regions(tile_map);
+    init_game_spawn_zone(game);
+    if (game->has_grids) {
+        build_world_grids(world);
+    }
+    if (game->lit) {
+        if (game->light.width != tile_map->width || game->light.height != tile_map->height) {
+            free_light_map(&game->light);
+            init_light_map(&game->light, tile_map);
+        } else {
+            invalidate_all_light(&game->light);
+        }
+    }
+    // The snapshot can hold any terrain so the pyramid is rebuilt the next time it's needed.
+    if (game->has_overview) {
+        free_overview(&game->overview);
+        game->has_overview = false;
+    }
+    if (renderer.zoom > 0) {
+        ensure_overview(game);
+    }
+    close_snapshot(&snapshot);
+}
+
+void get_game_counts(const GameState *game, GameCounts *counts)
+{
+    const WorldState *world = &game->worlds[game->front];
+    counts->children = world->children.size;
+    counts->females = world->females.size;
+    counts->virgin_females = world->virgin_females.size;
+    counts->population = world->population;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_sprite(uint64_t hash, const Sprite *sprite)
+{
+    hash = hash_bytes(hash, &sprite->x, sizeof(sprite->x));
+    hash = hash_bytes(hash, &sprite->y, sizeof(sprite->y));
+    return hash_bytes(hash, &sprite->facing, sizeof(sprite->facing));
+}
+
+static uint64_t hash_mob_array(uint64_t hash, const MobArray *array)
+{
+    for (size_t i = 0; i < array->size; i++) {
+        hash = hash_sprite(hash, &array->mobs[i].sprite);
+        hash = hash_bytes(hash, &array->mobs[i].x_direction, sizeof(int8_t));
+        hash = hash_bytes(hash, &array->mobs[i].y_direction, sizeof(int8_t));
+    }
+    return hash;
+}
+
+// FNV-1a over the simulation state. Two runs of the same replay should always produce the same value.
+uint64_t hash_game_state(const GameState *game)
+{
+    const WorldState *world = &game->worlds[game->front];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hash_sprite(hash, &world->player);
+    hash = hash_mob_array(hash, &world->children);
+    hash = hash_mob_array(hash, &world->females);
+    hash = hash_mob_array(hash, &world->virgin_females);
+    // Nothing is usually queued, which leaves the hash as it was before breeding was queued.
+    const BreedQueue *queue = &game->breed_queue;
+    hash = hash_bytes(hash, queue->virgins + queue->head, (queue->size - queue->head) * sizeof(uint32_t));
+    return hash_bytes(hash, &world->population, sizeof(world->population));
+}
 
+// All world drawing goes through here. Sprites are always drawn at their source size.
+static void draw_sprite(const SDL_Rect *srcrect, const SDL_FRect *dstrect, SDL_RendererFlip flip)
+{
+    if (renderer.software) {
+        draw_count_raster(raster_blit(srcrect, (int)floorf(dstrect->x), (int)floorf(dstrect->y), flip != SDL_FLIP_NONE));
+    } else if (flip == SDL_FLIP_NONE) {
+        draw_copy_f(sprite_texture, srcrect, dstrect);
+    } else {
+        draw_copy_ex_f(sprite_texture, srcrect, dstrect, flip);
+    }
+}
+
+// phase is 1 when MOB_ANIMATION(ticks) is set. Works out once per frame rather than per mob.
+static void render_mob(const Sprite *sprite, const MobFrame *frames, const Sprite *player, int phase)
+{
+    const MobFrame *frame = &frames[MOB_FRAME(sprite->facing, sprite->walking, phase)];
     SDL_FRect dstrect;
-    dstrect.x = (sprite->x - player.x) + (WORLD_WIDTH * 0.5f) - (TILE_SIZE * 0.5f);
-    dstrect.y = (sprite->y - player.y) + (WORLD_HEIGHT * 0.5f) - (TILE_SIZE * 0.5f);
+    dstrect.x = POSITION_TO_FLOAT(sprite->x - player->x) + (WORLD_WIDTH * 0.5f) - (TILE_SIZE * 0.5f);
+    dstrect.y = POSITION_TO_FLOAT(sprite->y - player->y) + (WORLD_HEIGHT * 0.5f) - (TILE_SIZE * 0.5f);
     dstrect.w = TILE_SIZE;
     dstrect.h = TILE_SIZE;
-    SDL_RenderCopyExF(renderer.sdl, sprite_texture, srcrect, &dstrect, 0, NULL, flip);
+    draw_sprite(frame->srcrect, &dstrect, frame->flip);
+}
+
+// Builds the overview pyramid if it isn't already. Does nothing without a renderer that can zoom.
+void ensure_overview(GameState *game)
+{
+    if (game->zoomable && !game->has_overview) {
+        init_overview(&game->overview, &game->tile_map, sprite_pixels, world_sprites, MOB_CELL_SIZE);
+        game->has_overview = true;
+    }
+}
+
+int get_max_zoom(const GameState *game)
+{
+    return game->zoomable ? get_overview_max_level(game->tile_map.width, game->tile_map.height) : 0;
+}
+
+/*
+ * Draws the map from the overview pyramid with mobs as a density map of the mob grid cells. The player is drawn full size so it can be found.
+ * Lighting is left out here. Torches are too small to matter at these scales.
+ */
+static void render_zoomed(GameState *game, int zoom, int64_t ticks)
+{
+    const WorldState *world = &game->worlds[game->front];
+    const Sprite *player = &world->player;
+    Overview *overview = &game->overview;
+    for (int c = 0; c < overview->density_width * overview->density_height; c++) {
+        overview->density_counts[c] = (world->children_grid.cell_start[c + 1] - world->children_grid.cell_start[c]) +
+            (world->females_grid.cell_start[c + 1] - world->females_grid.cell_start[c]) +
+            (world->virgin_females_grid.cell_start[c + 1] - world->virgin_females_grid.cell_start[c]);
+    }
+    update_density_map(overview);
+    float player_x = POSITION_TO_FLOAT(player->x);
+    float player_y = POSITION_TO_FLOAT(player->y);
+    float camera_x, camera_y;
+    get_overview_camera(overview, zoom, player_x, player_y, &camera_x, &camera_y);
+    render_overview(overview, zoom, camera_x, camera_y);
+    // render_mob draws relative to the player so give it a stand in at the spot that puts the real player in the right place.
+    float world_per_pixel = (float)(1 << zoom);
+    Sprite origin = *player;
+    origin.x = FLOAT_TO_POSITION(player_x - ((player_x - camera_x) / world_per_pixel) + (WORLD_WIDTH * 0.5f));
+    origin.y = FLOAT_TO_POSITION(player_y - ((player_y - camera_y) / world_per_pixel) + (WORLD_HEIGHT * 0.5f));
+    render_mob(player, player_frames, &origin, MOB_ANIMATION(ticks) != 0);
 }
 
 /*
- * Currently we're just rendering everything.  I had some code previously to only render the part of the tile map that was on screen.
+ * Mobs are culled through the grids update_game builds so only the ones near the camera are drawn.
+ * Tiles are still all submitted.  I had some code previously to only render the part of the tile map that was on screen.
  * Checkout commit a2c5b2367b409036eb8728dcfc55f7581da87e3b to see old code.
  *
  * However, it was hard to follow and I believe incorrect as well (some tiles appeared slightly off center).
@@ -358,11 +1351,37 @@ static void render_mob(Sprite *sprite, const SDL_Rect *srcrect, int64_t ticks)
  *
  * May still want to revisit optimizations here in the future.
  */
-void render_game(float delta, int64_t ticks)
+void render_game(GameState *game, float delta, int64_t ticks)
 {
-    for (int y = 0; y < tile_map.height; y++) {
-        for (int x = 0; x < tile_map.width; x++) {
-            uint16_t tile = tile_map.tiles[(y * tile_map.width) + x];
+    const TileMap *tile_map = &game->tile_map;
+    const WorldState *world = &game->worlds[game->front];
+    const Sprite *player = &world->player;
+    float player_x = POSITION_TO_FLOAT(player->x);
+    float player_y = POSITION_TO_FLOAT(player->y);
+    // Only the parts of the caches that set_game_tile touched are redone.
+    for (int i = 0; i < game->tile_map.dirty.count; i++) {
+        const SDL_Rect *rect = &game->tile_map.dirty.rects[i];
+        if (game->lit) {
+            for (int y = rect->y; y < rect->y + rect->h; y++) {
+                for (int x = rect->x; x < rect->x + rect->w; x++) {
+                    invalidate_light(&game->light, x, y);
+                }
+            }
+        }
+        if (game->has_overview) {
+            update_overview(&game->overview, tile_map, rect);
+        }
+    }
+    game->tile_map.dirty.count = 0;
+    int zoom = SDL_min(renderer.zoom, get_max_zoom(game));
+    if (zoom > 0) {
+        ensure_overview(game);
+        render_zoomed(game, zoom, ticks);
+        return;
+    }
+    for (int y = 0; y < tile_map->height; y++) {
+        for (int x = 0; x < tile_map->width; x++) {
+            uint16_t tile = tile_map->tiles[(y * tile_map->width) + x];
             const SDL_Rect *sprite;
             if (tile == TILE_WATER && WATER_ANIMATION(ticks)) {
                 sprite = &world_sprites[SPRITE_WATER_1];
@@ -370,70 +1389,81 @@ void render_game(float delta, int64_t ticks)
                 sprite = &world_sprites[BACKGROUND(tile)];
             }
             SDL_FRect dstrect;
-            dstrect.x = ((float)x * (float)TILE_SIZE) - player.x + (WORLD_WIDTH * 0.5f);
-            dstrect.y = ((float)y * (float)TILE_SIZE) - player.y + (WORLD_HEIGHT * 0.5f);
+            dstrect.x = ((float)x * (float)TILE_SIZE) - player_x + (WORLD_WIDTH * 0.5f);
+            dstrect.y = ((float)y * (float)TILE_SIZE) - player_y + (WORLD_HEIGHT * 0.5f);
             dstrect.w = TILE_SIZE;
             dstrect.h = TILE_SIZE;
-            SDL_RenderCopyF(renderer.sdl, sprite_texture, sprite, &dstrect);
+            draw_sprite(sprite, &dstrect, SDL_FLIP_NONE);
         }
     }
 
-    for (int y = 0; y < tile_map.height; y++) {
-        for (int x = 0; x < tile_map.width; x++) {
-            uint16_t foreground = FOREGROUND(tile_map.tiles[(y * tile_map.width) + x]);
+    for (int y = 0; y < tile_map->height; y++) {
+        for (int x = 0; x < tile_map->width; x++) {
+            uint16_t foreground = FOREGROUND(tile_map->tiles[(y * tile_map->width) + x]);
             if (foreground == SPRITE_TORCH) {
                 SDL_FRect dstrect;
-                dstrect.x = ((float)x * (float)TILE_SIZE) - player.x + (WORLD_WIDTH * 0.5f);
-                dstrect.y = ((float)y * (float)TILE_SIZE) - player.y + (WORLD_HEIGHT * 0.5f);
+                dstrect.x = ((float)x * (float)TILE_SIZE) - player_x + (WORLD_WIDTH * 0.5f);
+                dstrect.y = ((float)y * (float)TILE_SIZE) - player_y + (WORLD_HEIGHT * 0.5f);
                 dstrect.w = TILE_SIZE;
                 dstrect.h = TILE_SIZE;
-                SDL_RenderCopyF(renderer.sdl, sprite_texture, &world_sprites[SPRITE_TORCH], &dstrect);
+                draw_sprite(&world_sprites[SPRITE_TORCH], &dstrect, SDL_FLIP_NONE);
             } else if (foreground == SPRITE_TREE_TOP) {
                 SDL_FRect tree_bottom;
-                tree_bottom.x = ((float)x * (float)TILE_SIZE) - player.x + (WORLD_WIDTH * 0.5f);
-                tree_bottom.y = ((float)y * (float)TILE_SIZE) - player.y + (WORLD_HEIGHT * 0.5f) + (float)TILE_SIZE;
+                tree_bottom.x = ((float)x * (float)TILE_SIZE) - player_x + (WORLD_WIDTH * 0.5f);
+                tree_bottom.y = ((float)y * (float)TILE_SIZE) - player_y + (WORLD_HEIGHT * 0.5f) + (float)TILE_SIZE;
                 tree_bottom.w = TILE_SIZE * 2.0f;
                 tree_bottom.h = TILE_SIZE;
-                SDL_RenderCopyF(renderer.sdl, sprite_texture, &world_sprites[SPRITE_TREE_BOTTOM], &tree_bottom);
+                draw_sprite(&world_sprites[SPRITE_TREE_BOTTOM], &tree_bottom, SDL_FLIP_NONE);
             }
         }
     }
 
-    for (size_t i = 0; i < children.size; i++) {
-        render_mob(&children.mobs[i].sprite, player_sprites, ticks);
-    }
-    for (size_t i = 0; i < females.size; i++) {
-        render_mob(&females.mobs[i].sprite, female_sprites, ticks);
-    }
-    for (size_t i = 0; i < virgin_females.size; i++) {
-        render_mob(&virgin_females.mobs[i].sprite, virgin_female_sprites, ticks);
+    // Mob centers that can put any pixel on screen. Anything outside this never reaches render_mob.
+    SDL_FRect camera;
+    camera.x = player_x - (WORLD_WIDTH * 0.5f) - (TILE_SIZE * 0.5f);
+    camera.y = player_y - (WORLD_HEIGHT * 0.5f) - (TILE_SIZE * 0.5f);
+    camera.w = WORLD_WIDTH + TILE_SIZE;
+    camera.h = WORLD_HEIGHT + TILE_SIZE;
+    visible_mobs_size = 0;
+    cull_mobs(&world->children_grid, &world->children, player_frames, &camera);
+    cull_mobs(&world->females_grid, &world->females, female_frames, &camera);
+    cull_mobs(&world->virgin_females_grid, &world->virgin_females, virgin_female_frames, &camera);
+    count_culled(world->children.size + world->females.size + world->virgin_females.size - visible_mobs_size);
+    int phase = MOB_ANIMATION(ticks) != 0;
+    for (size_t i = 0; i < visible_mobs_size; i++) {
+        render_mob(visible_mobs[i].sprite, visible_mobs[i].frames, player, phase);
     }
-    render_mob(&player, player_sprites, ticks);
+    render_mob(player, player_frames, player, phase);
 
-    for (int y = 0; y < tile_map.height; y++) {
-        for (int x = 0; x < tile_map.width; x++) {
-            uint16_t tile = tile_map.tiles[(y * tile_map.width) + x];
+    for (int y = 0; y < tile_map->height; y++) {
+        for (int x = 0; x < tile_map->width; x++) {
+            uint16_t tile = tile_map->tiles[(y * tile_map->width) + x];
             if (tile == TILE_TREE) {
                 SDL_FRect tree_top;
-                tree_top.x = ((float)x * (float)TILE_SIZE) - player.x + (WORLD_WIDTH * 0.5f);
-                tree_top.y = ((float)y * (float)TILE_SIZE) - player.y + (WORLD_HEIGHT * 0.5f);
+                tree_top.x = ((float)x * (float)TILE_SIZE) - player_x + (WORLD_WIDTH * 0.5f);
+                tree_top.y = ((float)y * (float)TILE_SIZE) - player_y + (WORLD_HEIGHT * 0.5f);
                 tree_top.w = TILE_SIZE * 2.0f;
                 tree_top.h = TILE_SIZE;
-                SDL_RenderCopyF(renderer.sdl, sprite_texture, &world_sprites[SPRITE_TREE_TOP], &tree_top);
+                draw_sprite(&world_sprites[SPRITE_TREE_TOP], &tree_top, SDL_FLIP_NONE);
             }
         }
     }
+
+    if (game->lit) {
+        update_light_map(&game->light, tile_map);
+        render_light_map(&game->light, player_x - (WORLD_WIDTH * 0.5f), player_y - (WORLD_HEIGHT * 0.5f));
+    }
 }
 
-void render_overlay(int64_t ticks)
+void render_overlay(const GameState *game, int64_t ticks)
 {
-    int timer = 300 - ((ticks - start_ticks) / 1000);
+    int timer = 300 - ((ticks - game->start_ticks) / 1000);
     int minutes = timer / 60;
     int seconds = timer % 60;
     char string_buffer[32];
     snprintf(string_buffer, sizeof(string_buffer), "%d:%02d", minutes, seconds);
     render_string_centered(string_buffer, renderer.width / 2, renderer.height - 15);
 
-    snprintf(string_buffer, sizeof(string_buffer), "Population: %d", (int)population);
+    snprintf(string_buffer, sizeof(string_buffer), "Population: %d", (int)game->worlds[game->front].population);
     render_string_right(string_buffer, renderer.width, 30);
 }
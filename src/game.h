@@ -1,13 +1,18 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "SDL.h"
 
+#include "pcgrandom.h"
+
 #define WORLD_WIDTH 300
 #define WORLD_HEIGHT 180
 
+#define TILE_SIZE 16
+
 #define SPRITE_GROUND 0
 #define SPRITE_GRASS 1
 #define SPRITE_FLOWER 2
@@ -37,11 +42,42 @@
 #define TILE_ICE (SPRITE_ICE | SOLID)
 #define TILE_TREE ((SPRITE_TREE_TOP << 7) | SOLID)
 
+#define BACKGROUND(tile) ((tile) & 127)
+#define FOREGROUND(tile) (((tile) >> 7) & 127)
+
+#define INPUT_RIGHT 1
+#define INPUT_LEFT 2
+#define INPUT_UP 4
+#define INPUT_DOWN 8
+
+#define DEFAULT_LEVEL "res/levels/ocean.png"
+#define SNAPSHOT_FILE "genesis.snap"
+
+// How a MobArray reacts to the player. Seeking and fleeing mobs steer using the shared flow field.
+#define MOB_WANDER 0
+#define MOB_SEEK 1
+#define MOB_FLEE 2
+
+// Tile areas changed since whoever owns this last cleared it. Overlapping rects are merged and a full list grows its last rect.
+#define MAX_DIRTY_RECTS 16
+
+typedef struct DirtyTiles
+{
+    int count;
+    SDL_Rect rects[MAX_DIRTY_RECTS];
+} DirtyTiles;
+
 typedef struct TileMap
 {
     int width;
     int height;
     uint16_t *tiles;
+    uint32_t num_regions;
+    uint32_t *regions;  // Connected walkable region of each tile. See build_regions
+    uint32_t *region_start;  // Tiles of region r are region_tiles[region_start[r]] to region_tiles[region_start[r + 1] - 1]
+    uint32_t *region_tiles;
+    bool region_lists_stale;  // update_regions patched regions without redoing region_start and region_tiles. Call build_regions before using them
+    DirtyTiles dirty;  // Changed by set_tile. Cleared by render_game once light and the overview caught up
 } TileMap;
 
 typedef struct Renderer
@@ -50,14 +86,42 @@ typedef struct Renderer
     int height;
     SDL_Renderer *sdl;
     SDL_Texture *world_target;
+    bool software;  // Draw the world on the CPU into software_target instead of through SDL_Renderer
+    SDL_Texture *software_target;
+    bool night;  // Darken the world and light it with torches
+    int zoom;  // 0 is full size. Each step halves the scale. Clamped to get_max_zoom when drawing
+    bool vsync;  // Presenting waits for the display refresh
 } Renderer;
 
+// Mob counts of the front world state.
+typedef struct GameCounts
+{
+    uint32_t children;
+    uint32_t females;
+    uint32_t virgin_females;
+    float population;
+} GameCounts;
+
+// Everything about one running world. Defined in game.c.
+typedef struct GameState GameState;
+
 extern const Uint8 *keyboard;
 extern Renderer renderer;
 
-void init_game(int64_t ticks);
-void render_game(float delta, int64_t ticks);
-void render_overlay(int64_t ticks);
-void update_game(float delta);
+GameState *init_game(int64_t ticks, const char *level, const RngState *rng, uint8_t children_behavior, bool play_sounds);
+void free_game(GameState *game);
+uint8_t read_keyboard(void);
+void render_game(GameState *game, float delta, int64_t ticks);
+void ensure_overview(GameState *game);
+int get_max_zoom(const GameState *game);
+void render_overlay(const GameState *game, int64_t ticks);
+void update_game(GameState *game, float delta, uint8_t input);
+void swap_game_state(GameState *game);
+void set_game_tile(GameState *game, int x, int y, uint16_t tile);
+void toggle_facing_tile(GameState *game);
+uint64_t hash_game_state(const GameState *game);
+void get_game_counts(const GameState *game, GameCounts *counts);
+void save_game(const GameState *game, const char *filename, int64_t ticks);
+void load_game(GameState *game, const char *filename, int64_t ticks);
 
 #endif
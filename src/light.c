@@ -0,0 +1,222 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "draw.h"
+#include "game.h"
+#include "light.h"
+#include "memory.h"
+
+// Chunk textures have a one texel border copied from the neighboring chunks so linear filtering doesn't leave seams.
+#define TEXTURE_SIZE (LIGHT_CHUNK_SIZE + 2)
+#define CHUNK_PIXELS (LIGHT_CHUNK_SIZE * TILE_SIZE)
+
+// Night time color where no torch reaches and the color right next to a torch. Multiplied over the world.
+#define AMBIENT_R 40
+#define AMBIENT_G 48
+#define AMBIENT_B 88
+#define TORCH_R 255
+#define TORCH_G 214
+#define TORCH_B 160
+
+void init_light_map(LightMap *light, const TileMap *tile_map)
+{
+    light->width = tile_map->width;
+    light->height = tile_map->height;
+    light->chunks_x = (tile_map->width + LIGHT_CHUNK_SIZE - 1) / LIGHT_CHUNK_SIZE;
+    light->chunks_y = (tile_map->height + LIGHT_CHUNK_SIZE - 1) / LIGHT_CHUNK_SIZE;
+    int num_chunks = light->chunks_x * light->chunks_y;
+    light->levels = tracked_calloc(MEMORY_RENDER, tile_map->width * tile_map->height, sizeof(uint8_t));
+    light->dirty = tracked_malloc(MEMORY_RENDER, num_chunks * sizeof(bool));
+    light->textures = tracked_malloc(MEMORY_RENDER, num_chunks * sizeof(SDL_Texture *));
+    if (light->levels == NULL || light->dirty == NULL || light->textures == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < num_chunks; i++) {
+        light->textures[i] = SDL_CreateTexture(renderer.sdl, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, TEXTURE_SIZE, TEXTURE_SIZE);
+        if (light->textures[i] == NULL) {
+            fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+        SDL_SetTextureBlendMode(light->textures[i], SDL_BLENDMODE_MOD);
+        SDL_SetTextureScaleMode(light->textures[i], SDL_ScaleModeLinear);
+    }
+    invalidate_all_light(light);
+    update_light_map(light, tile_map);
+}
+
+void free_light_map(LightMap *light)
+{
+    for (int i = 0; i < light->chunks_x * light->chunks_y; i++) {
+        SDL_DestroyTexture(light->textures[i]);
+    }
+    tracked_free(light->textures);
+    tracked_free(light->dirty);
+    tracked_free(light->levels);
+}
+
+void invalidate_all_light(LightMap *light)
+{
+    memset(light->dirty, true, light->chunks_x * light->chunks_y * sizeof(bool));
+    light->any_dirty = true;
+}
+
+/*
+ * Call when tile (x, y) changes. A torch there changes light within LIGHT_RADIUS of it and a wall there can cast a shadow
+ * on anything a torch within LIGHT_RADIUS of it reaches. One more tile covers the texture borders.
+ */
+void invalidate_light(LightMap *light, int x, int y)
+{
+    int reach = (LIGHT_RADIUS * 2) + 1;
+    int min_x = SDL_max(0, (x - reach) / LIGHT_CHUNK_SIZE);
+    int min_y = SDL_max(0, (y - reach) / LIGHT_CHUNK_SIZE);
+    int max_x = SDL_min(light->chunks_x - 1, (x + reach) / LIGHT_CHUNK_SIZE);
+    int max_y = SDL_min(light->chunks_y - 1, (y + reach) / LIGHT_CHUNK_SIZE);
+    for (int cy = min_y; cy <= max_y; cy++) {
+        for (int cx = min_x; cx <= max_x; cx++) {
+            light->dirty[(cy * light->chunks_x) + cx] = true;
+            light->any_dirty = true;
+        }
+    }
+}
+
+static bool is_solid(const TileMap *tile_map, int x, int y)
+{
+    return tile_map->tiles[(y * tile_map->width) + x] & SOLID;
+}
+
+// Walks the line between the tile centers. Only tiles strictly between the two block so walls facing a torch still get lit.
+static bool line_of_sight(const TileMap *tile_map, int x0, int y0, int x1, int y1)
+{
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    while (1) {
+        int e2 = error * 2;
+        if (e2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+        if (x0 == x1 && y0 == y1) {
+            return true;
+        }
+        if (is_solid(tile_map, x0, y0)) {
+            return false;
+        }
+    }
+}
+
+// Adds one torch's light to the tiles of the chunk spanning [min_x, max_x) x [min_y, max_y). Overlapping torches take the brightest.
+static void light_chunk_from_torch(LightMap *light, const TileMap *tile_map, int torch_x, int torch_y, int min_x, int min_y, int max_x, int max_y)
+{
+    for (int y = SDL_max(min_y, torch_y - LIGHT_RADIUS); y < SDL_min(max_y, torch_y + LIGHT_RADIUS + 1); y++) {
+        for (int x = SDL_max(min_x, torch_x - LIGHT_RADIUS); x < SDL_min(max_x, torch_x + LIGHT_RADIUS + 1); x++) {
+            float distance = sqrtf((float)(((x - torch_x) * (x - torch_x)) + ((y - torch_y) * (y - torch_y))));
+            if (distance > LIGHT_RADIUS) {
+                continue;
+            }
+            float falloff = 1.0f - (distance / (LIGHT_RADIUS + 1.0f));
+            uint8_t level = (uint8_t)(falloff * falloff * 255.0f);
+            uint8_t *current = &light->levels[(y * light->width) + x];
+            if (level > *current && (distance == 0.0f || line_of_sight(tile_map, torch_x, torch_y, x, y))) {
+                *current = level;
+            }
+        }
+    }
+}
+
+static void light_chunk(LightMap *light, const TileMap *tile_map, int cx, int cy)
+{
+    int min_x = cx * LIGHT_CHUNK_SIZE;
+    int min_y = cy * LIGHT_CHUNK_SIZE;
+    int max_x = SDL_min(light->width, min_x + LIGHT_CHUNK_SIZE);
+    int max_y = SDL_min(light->height, min_y + LIGHT_CHUNK_SIZE);
+    for (int y = min_y; y < max_y; y++) {
+        memset(&light->levels[(y * light->width) + min_x], 0, max_x - min_x);
+    }
+    for (int y = SDL_max(0, min_y - LIGHT_RADIUS); y < SDL_min(light->height, max_y + LIGHT_RADIUS); y++) {
+        for (int x = SDL_max(0, min_x - LIGHT_RADIUS); x < SDL_min(light->width, max_x + LIGHT_RADIUS); x++) {
+            if (FOREGROUND(tile_map->tiles[(y * tile_map->width) + x]) == SPRITE_TORCH) {
+                light_chunk_from_torch(light, tile_map, x, y, min_x, min_y, max_x, max_y);
+            }
+        }
+    }
+}
+
+static uint32_t light_color(uint8_t level)
+{
+    uint32_t r = AMBIENT_R + (((TORCH_R - AMBIENT_R) * level) / 255);
+    uint32_t g = AMBIENT_G + (((TORCH_G - AMBIENT_G) * level) / 255);
+    uint32_t b = AMBIENT_B + (((TORCH_B - AMBIENT_B) * level) / 255);
+    return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+static void upload_chunk(LightMap *light, int cx, int cy)
+{
+    uint32_t pixels[TEXTURE_SIZE * TEXTURE_SIZE];
+    for (int ty = 0; ty < TEXTURE_SIZE; ty++) {
+        // Clamp at the map edges so the border repeats the outermost tiles.
+        int y = SDL_max(0, SDL_min(light->height - 1, (cy * LIGHT_CHUNK_SIZE) + ty - 1));
+        for (int tx = 0; tx < TEXTURE_SIZE; tx++) {
+            int x = SDL_max(0, SDL_min(light->width - 1, (cx * LIGHT_CHUNK_SIZE) + tx - 1));
+            pixels[(ty * TEXTURE_SIZE) + tx] = light_color(light->levels[(y * light->width) + x]);
+        }
+    }
+    SDL_UpdateTexture(light->textures[(cy * light->chunks_x) + cx], NULL, pixels, TEXTURE_SIZE * sizeof(uint32_t));
+}
+
+// Recomputes dirty chunks. Does nothing (and costs nothing) until a tile changes.
+void update_light_map(LightMap *light, const TileMap *tile_map)
+{
+    if (!light->any_dirty) {
+        return;
+    }
+    // All levels first since textures read the borders of neighboring chunks.
+    for (int cy = 0; cy < light->chunks_y; cy++) {
+        for (int cx = 0; cx < light->chunks_x; cx++) {
+            if (light->dirty[(cy * light->chunks_x) + cx]) {
+                light_chunk(light, tile_map, cx, cy);
+            }
+        }
+    }
+    for (int cy = 0; cy < light->chunks_y; cy++) {
+        for (int cx = 0; cx < light->chunks_x; cx++) {
+            if (light->dirty[(cy * light->chunks_x) + cx]) {
+                upload_chunk(light, cx, cy);
+                light->dirty[(cy * light->chunks_x) + cx] = false;
+            }
+        }
+    }
+    light->any_dirty = false;
+}
+
+// Multiplies the light over whatever is on the current render target. camera is the world position of the top left corner of the view.
+void render_light_map(const LightMap *light, float camera_x, float camera_y)
+{
+    int min_x = SDL_max(0, (int)floorf(camera_x / CHUNK_PIXELS));
+    int min_y = SDL_max(0, (int)floorf(camera_y / CHUNK_PIXELS));
+    int max_x = SDL_min(light->chunks_x - 1, (int)floorf((camera_x + WORLD_WIDTH) / CHUNK_PIXELS));
+    int max_y = SDL_min(light->chunks_y - 1, (int)floorf((camera_y + WORLD_HEIGHT) / CHUNK_PIXELS));
+    SDL_Rect srcrect = {1, 1, LIGHT_CHUNK_SIZE, LIGHT_CHUNK_SIZE};
+    for (int cy = min_y; cy <= max_y; cy++) {
+        for (int cx = min_x; cx <= max_x; cx++) {
+            SDL_FRect dstrect;
+            dstrect.x = ((float)cx * CHUNK_PIXELS) - camera_x;
+            dstrect.y = ((float)cy * CHUNK_PIXELS) - camera_y;
+            dstrect.w = CHUNK_PIXELS;
+            dstrect.h = CHUNK_PIXELS;
+            draw_copy_f(light->textures[(cy * light->chunks_x) + cx], &srcrect, &dstrect);
+        }
+    }
+}
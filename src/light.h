@@ -0,0 +1,35 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+
+#include "game.h"
+
+// Light maps are cached per square chunk of tiles. One texel per tile, stretched over the chunk with linear filtering.
+#define LIGHT_CHUNK_SIZE 16
+// How far (in tiles) torch light reaches.
+#define LIGHT_RADIUS 6
+
+typedef struct LightMap
+{
+    int width;
+    int height;
+    int chunks_x;
+    int chunks_y;
+    uint8_t *levels;  // Torch light of each tile. 0 is ambient only, 255 is right next to a torch
+    bool *dirty;
+    SDL_Texture **textures;
+    bool any_dirty;
+} LightMap;
+
+void init_light_map(LightMap *light, const TileMap *tile_map);
+void free_light_map(LightMap *light);
+void invalidate_light(LightMap *light, int x, int y);
+void invalidate_all_light(LightMap *light);
+void update_light_map(LightMap *light, const TileMap *tile_map);
+void render_light_map(const LightMap *light, float camera_x, float camera_y);
+
+#endif
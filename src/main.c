@@ -1,14 +1,41 @@
+#include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL.h"
 
 #include "audio.h"
 #include "assets.h"
+#include "batch.h"
+#include "draw.h"
 #include "font.h"
+#include "pacer.h"
 #include "pcgrandom.h"
+#include "pipeline.h"
 #include "game.h"
+#include "memory.h"
+#include "metrics.h"
+#include "raster.h"
+#include "replay.h"
+#include "resample.h"
+
+// Frames the main loop gets to grow its buffers before --alloc-check starts reporting allocations. Reporting also waits for every clip to load.
+#define ALLOC_WARMUP_FRAMES 300
+// While the window is minimized or hidden nothing is drawn and the simulation only ticks this often.
+#define HIDDEN_TICK_MS 100
+// Frame cap while the window is visible but doesn't have focus.
+#define UNFOCUSED_FPS 30
+
+static void update_output_size(void)
+{
+    if (SDL_GetRendererOutputSize(renderer.sdl, &renderer.width, &renderer.height) != 0) {
+        fprintf(stderr, "SDL_GetRendererOutputSize failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+}
 
 static void init_sdl()
 {
@@ -35,84 +62,417 @@ static void init_sdl()
         fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
         exit(EXIT_FAILURE);
     }
+    if (renderer.software) {
+        renderer.software_target = SDL_CreateTexture(renderer.sdl, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, WORLD_WIDTH, WORLD_HEIGHT);
+        if (renderer.software_target == NULL) {
+            fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+    }
     #ifndef BURNUP_MY_CPU
     if (SDL_RenderSetVSync(renderer.sdl, 1) != 0) {
         fprintf(stderr, "Warning: SDL_RenderSetVSync failed: %s\n", SDL_GetError());
+    } else {
+        renderer.vsync = true;
     }
     #endif
     keyboard = SDL_GetKeyboardState(NULL);
-    if (SDL_GetRendererOutputSize(renderer.sdl, &renderer.width, &renderer.height) != 0) {
-        fprintf(stderr, "SDL_GetRendererOutputSize failed: %s\n", SDL_GetError());
-        exit(EXIT_FAILURE);
+    update_output_size();
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--fps <target frames per second, 0 for uncapped>] [--level <png>] [--children wander|seek|flee] [--resample fast|medium|high|reference] [--low-latency] [--software] [--night] [--pipeline] [--alloc-check] [--metrics <file> | --metrics unix:<socket>] [--metrics-sink <socket>] [--load <snapshot>] [--record <file> | --replay <file> [--headless | --batch <worlds>]]\n", program);
+    exit(EXIT_FAILURE);
+}
+
+// Runs a replay through update_game as fast as possible with no window, audio or rendering.
+static void run_headless(Replay *replay)
+{
+    GameState *game = init_game(get_time_ns() / NS_PER_MS, replay->level, &replay->rng, replay->children_behavior, false);
+    float delta;
+    uint8_t input;
+    int64_t worst = 0;
+    int64_t start = get_time_ns();
+    while (read_tick(replay, &delta, &input)) {
+        int64_t tick_start = get_time_ns();
+        update_game(game, delta, input);
+        swap_game_state(game);
+        int64_t tick_time = get_time_ns() - tick_start;
+        if (tick_time > worst) {
+            worst = tick_time;
+        }
     }
+    int64_t total = get_time_ns() - start;
+    printf("Replayed %u ticks in %.3fms. Average: %.3fus Worst: %.3fus\n", replay->ticks,
+        (double)total / NS_PER_MS, replay->ticks ? (double)total / replay->ticks / 1000.0 : 0.0, (double)worst / 1000.0);
+    printf("State hash: %016llx\n", (unsigned long long)hash_game_state(game));
+    free_game(game);
 }
 
-int main(int argv, char **argc)
+int main(int argc, char **argv)
 {
-    seed_rng();
+    #ifdef BURNUP_MY_CPU
+    int target_fps = 0;
+    #else
+    // FPS cap to 500fps.  Should not happen if vsync is working correctly.
+    int target_fps = 500;
+    #endif
+    bool fps_given = false;
+    init_memory();
+    const char *level = DEFAULT_LEVEL;
+    uint8_t children_behavior = MOB_WANDER;
+    const char *record_file = NULL;
+    const char *replay_file = NULL;
+    const char *load_file = NULL;
+    bool headless = false;
+    int batch_worlds = 0;
+    int resample_quality = RESAMPLE_MEDIUM;
+    bool low_latency = false;
+    bool pipelined = false;
+    bool alloc_check = false;
+    const char *metrics_target = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            char *end;
+            long fps = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || fps < 0 || fps > INT_MAX) {
+                usage(argv[0]);
+            }
+            target_fps = fps;
+            fps_given = true;
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            level = argv[++i];
+        } else if (strcmp(argv[i], "--children") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "wander") == 0) {
+                children_behavior = MOB_WANDER;
+            } else if (strcmp(argv[i], "seek") == 0) {
+                children_behavior = MOB_SEEK;
+            } else if (strcmp(argv[i], "flee") == 0) {
+                children_behavior = MOB_FLEE;
+            } else {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--resample") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fast") == 0) {
+                resample_quality = RESAMPLE_FAST;
+            } else if (strcmp(argv[i], "medium") == 0) {
+                resample_quality = RESAMPLE_MEDIUM;
+            } else if (strcmp(argv[i], "high") == 0) {
+                resample_quality = RESAMPLE_HIGH;
+            } else if (strcmp(argv[i], "reference") == 0) {
+                resample_quality = RESAMPLE_REFERENCE;
+            } else {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--software") == 0) {
+            renderer.software = true;
+        } else if (strcmp(argv[i], "--night") == 0) {
+            renderer.night = true;
+        } else if (strcmp(argv[i], "--alloc-check") == 0) {
+            alloc_check = true;
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_target = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-sink") == 0 && i + 1 < argc) {
+            run_metrics_sink(argv[++i]);
+            return EXIT_SUCCESS;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipelined = true;
+        } else if (strcmp(argv[i], "--low-latency") == 0) {
+            low_latency = true;
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load_file = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_worlds = atoi(argv[++i]);
+            if (batch_worlds <= 0) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    // Replays start from a fresh level so restoring a snapshot would break determinism.
+    if ((record_file && replay_file) || (headless && !replay_file) || (batch_worlds && (!replay_file || headless)) || (load_file && (record_file || replay_file))) {
+        usage(argv[0]);
+    }
+    if (renderer.night && renderer.software) {
+        fprintf(stderr, "Warning: --night is not supported by the software renderer\n");
+    }
+    Replay replay;
+    RngState rng;
+    if (replay_file) {
+        open_replay(&replay, replay_file);
+        level = replay.level;
+        rng = replay.rng;
+        children_behavior = replay.children_behavior;
+        if (headless || batch_worlds) {
+            if (batch_worlds) {
+                run_batch(&replay, batch_worlds);
+            } else {
+                run_headless(&replay);
+            }
+            close_replay(&replay);
+            return EXIT_SUCCESS;
+        }
+    } else {
+        seed_rng(&rng);
+        if (record_file) {
+            start_recording(&replay, record_file, level, &rng, children_behavior);
+        }
+    }
     init_sdl();
     init_fonts();
-    init_audio();
+    init_audio(resample_quality, low_latency);
+    // Clips normally load on first use. Those loads allocate so with --alloc-check they all happen during warm up instead.
+    if (alloc_check) {
+        prefetch_all_sounds();
+    }
     float delta = 0.0f;
-    float fps_report = 0.0f;
-    int frames = 0;
-    float frequency = SDL_GetPerformanceFrequency();
-    Uint64 start = SDL_GetPerformanceCounter();
-    int64_t ticks = ((start / frequency) * 1000.0f) + 0.5f;
-    init_game(ticks);
+    int64_t fps_report = 0;
+    bool show_draw_stats = false;
+    bool hidden = false;
+    uint32_t frame_count = 0;
+    bool warmed_up = false;
+    // With vsync on the display paces frames. The default cap is only a fallback for when it couldn't be enabled.
+    if (renderer.vsync && !fps_given) {
+        target_fps = 0;
+    }
+    FramePacer pacer;
+    init_pacer(&pacer, target_fps);
+    pacer.vsync = renderer.vsync;
+    int64_t start = get_time_ns();
+    int64_t ticks = start / NS_PER_MS;
+    GameState *game = init_game(ticks, level, &rng, children_behavior, true);
+    if (load_file) {
+        load_game(game, load_file, ticks);
+    }
+    if (pipelined) {
+        start_pipeline(game);
+    }
+    if (metrics_target) {
+        start_metrics(metrics_target);
+    }
     while (1) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
+                if (pipelined) {
+                    stop_pipeline();
+                }
+                stop_metrics();
+                if (record_file) {
+                    printf("Recorded %u ticks. State hash: %016llx\n", replay.ticks, (unsigned long long)hash_game_state(game));
+                    close_replay(&replay);
+                }
                 return EXIT_SUCCESS;
             }
+            /*
+             * The output size only changes on resize so it's queried here instead of every frame.
+             * Hidden windows skip drawing entirely and unfocused ones drop to UNFOCUSED_FPS so background instances barely use the CPU.
+             */
+            if (event.type == SDL_WINDOWEVENT) {
+                switch (event.window.event) {
+                    case SDL_WINDOWEVENT_SIZE_CHANGED:
+                        update_output_size();
+                        break;
+                    case SDL_WINDOWEVENT_MINIMIZED:
+                    case SDL_WINDOWEVENT_HIDDEN:
+                        hidden = true;
+                        break;
+                    case SDL_WINDOWEVENT_RESTORED:
+                    case SDL_WINDOWEVENT_MAXIMIZED:
+                    case SDL_WINDOWEVENT_SHOWN:
+                        hidden = false;
+                        break;
+                    case SDL_WINDOWEVENT_FOCUS_LOST:
+                        init_pacer(&pacer, target_fps > 0 && target_fps < UNFOCUSED_FPS ? target_fps : UNFOCUSED_FPS);
+                        break;
+                    case SDL_WINDOWEVENT_FOCUS_GAINED:
+                        init_pacer(&pacer, target_fps);
+                        break;
+                }
+            }
+            if (event.type == SDL_KEYDOWN && !event.key.repeat && event.key.keysym.scancode == SDL_SCANCODE_F3) {
+                show_draw_stats = !show_draw_stats;
+            }
+            // Zoom only changes what's drawn so it works while recording and replaying too.
+            if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_MINUS) {
+                // The overview is built on first use. That's expected so it isn't reported.
+                set_allocation_guard(false);
+                ensure_overview(game);
+                set_allocation_guard(warmed_up);
+                renderer.zoom = SDL_min(renderer.zoom + 1, get_max_zoom(game));
+            } else if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_EQUALS) {
+                renderer.zoom = SDL_max(renderer.zoom - 1, 0);
+            }
+            // Snapshots and tile edits change simulation state outside of the recorded input so they're disabled while recording or replaying.
+            if (event.type == SDL_KEYDOWN && !event.key.repeat && !record_file && !replay_file) {
+                if (event.key.keysym.scancode == SDL_SCANCODE_F6) {
+                    if (pipelined) {
+                        finish_update();
+                    }
+                    toggle_facing_tile(game);
+                } else if (event.key.keysym.scancode == SDL_SCANCODE_F5) {
+                    if (pipelined) {
+                        finish_update();
+                    }
+                    int64_t save_start = get_time_ns();
+                    save_game(game, SNAPSHOT_FILE, ticks);
+                    printf("Saved %s in %.3fms\n", SNAPSHOT_FILE, (double)(get_time_ns() - save_start) / NS_PER_MS);
+                } else if (event.key.keysym.scancode == SDL_SCANCODE_F9) {
+                    FILE *file = fopen(SNAPSHOT_FILE, "rb");
+                    if (file == NULL) {
+                        printf("No snapshot to load. Press F5 to save one\n");
+                        continue;
+                    }
+                    fclose(file);
+                    if (pipelined) {
+                        finish_update();
+                    }
+                    // Loading a snapshot can resize everything. That's expected so it isn't reported.
+                    set_allocation_guard(false);
+                    int64_t load_start = get_time_ns();
+                    load_game(game, SNAPSHOT_FILE, ticks);
+                    set_allocation_guard(warmed_up);
+                    printf("Loaded %s in %.3fms\n", SNAPSHOT_FILE, (double)(get_time_ns() - load_start) / NS_PER_MS);
+                }
+            }
         }
-        SDL_SetRenderTarget(renderer.sdl, NULL);
-        SDL_RenderClear(renderer.sdl);
-        if (SDL_GetRendererOutputSize(renderer.sdl, &renderer.width, &renderer.height) != 0) {
-            fprintf(stderr, "SDL_GetRendererOutputSize failed: %s\n", SDL_GetError());
-            exit(EXIT_FAILURE);
+        uint8_t input;
+        if (replay_file) {
+            if (!read_tick(&replay, &delta, &input)) {
+                if (pipelined) {
+                    stop_pipeline();
+                }
+                stop_metrics();
+                printf("Replay finished after %u ticks. State hash: %016llx\n", replay.ticks, (unsigned long long)hash_game_state(game));
+                close_replay(&replay);
+                return EXIT_SUCCESS;
+            }
+        } else {
+            input = read_keyboard();
+            if (record_file) {
+                record_tick(&replay, delta, input);
+            }
         }
-        SDL_SetRenderTarget(renderer.sdl, renderer.world_target);
-        SDL_RenderClear(renderer.sdl);
-        update_game(delta);
-        render_game(delta, ticks);
-        SDL_SetRenderTarget(renderer.sdl, NULL);
-        float x_scale = (float)renderer.width / (float)WORLD_WIDTH;
-        float y_scale = (float)renderer.height / (float)WORLD_HEIGHT;
-        float scale;
-        if (x_scale < y_scale) {
-            scale = x_scale;
+        int64_t update_start = get_time_ns();
+        // When pipelined the next tick is simulated on the update thread while this frame renders the tick that just finished.
+        if (pipelined) {
+            finish_update();
+            begin_update(delta, input);
         } else {
-            scale = y_scale;
+            update_game(game, delta, input);
+            swap_game_state(game);
         }
-        SDL_FRect dstrect;
-        dstrect.w = (float)WORLD_WIDTH * scale;
-        dstrect.h = (float)WORLD_HEIGHT * scale;
-        dstrect.x = ((float)renderer.width - dstrect.w) * 0.5f;
-        dstrect.y = ((float)renderer.height - dstrect.h) * 0.5f;
-        SDL_RenderCopyF(renderer.sdl, renderer.world_target, NULL, &dstrect);
-        render_overlay(ticks);
-        SDL_RenderPresent(renderer.sdl);
-        Uint64 end = SDL_GetPerformanceCounter();
-        delta = (end - start) / frequency;
-        #ifndef BURNUP_MY_CPU
-        // FPS cap to 500fps.  Should not happen if vsync is working correctly.
-        if (delta < 0.002f) {
-            SDL_Delay(2);
-            end = SDL_GetPerformanceCounter();
-            delta = (end - start) / frequency;
+        int64_t render_start = get_time_ns();
+        int64_t render_ns = 0;
+        if (hidden) {
+            // Nothing is drawn. The simulation (and any recording) keeps going at a low rate and waiting on events wakes up as soon as the window is back.
+            SDL_WaitEventTimeout(NULL, HIDDEN_TICK_MS);
+        } else {
+            begin_draw_frame();
+            draw_set_target(NULL);
+            draw_clear();
+            SDL_Texture *world_texture;
+            if (renderer.software) {
+                clear_raster();
+                world_texture = renderer.software_target;
+            } else {
+                draw_set_target(renderer.world_target);
+                draw_clear();
+                world_texture = renderer.world_target;
+            }
+            render_game(game, delta, ticks);
+            if (renderer.software) {
+                present_raster(renderer.software_target);
+            }
+            draw_set_target(NULL);
+            float x_scale = (float)renderer.width / (float)WORLD_WIDTH;
+            float y_scale = (float)renderer.height / (float)WORLD_HEIGHT;
+            float scale;
+            if (x_scale < y_scale) {
+                scale = x_scale;
+            } else {
+                scale = y_scale;
+            }
+            SDL_FRect dstrect;
+            dstrect.w = (float)WORLD_WIDTH * scale;
+            dstrect.h = (float)WORLD_HEIGHT * scale;
+            dstrect.x = ((float)renderer.width - dstrect.w) * 0.5f;
+            dstrect.y = ((float)renderer.height - dstrect.h) * 0.5f;
+            draw_copy_f(world_texture, NULL, &dstrect);
+            render_overlay(game, ticks);
+            if (show_draw_stats) {
+                render_draw_stats(10, 30);
+            }
+            SDL_RenderPresent(renderer.sdl);
+            render_ns = get_time_ns() - render_start;
+            pace_frame(&pacer);
+        }
+        frame_count++;
+        if (warmed_up) {
+            report_guard_violations();
+        }
+        if (alloc_check && !warmed_up && frame_count >= ALLOC_WARMUP_FRAMES && all_sounds_ready()) {
+            printf("Warm up done. Reporting every allocation from now on\n");
+            warmed_up = true;
+            set_allocation_guard(true);
+        }
+        int64_t end = get_time_ns();
+        if (metrics_target) {
+            FrameMetrics frame_metrics;
+            frame_metrics.frame_ns = end - start;
+            frame_metrics.update_ns = render_start - update_start;
+            frame_metrics.render_ns = render_ns;
+            get_game_counts(game, &frame_metrics.counts);
+            record_frame_metrics(&frame_metrics);
         }
-        #endif
-        frames++;
-        fps_report += delta;
-        if (fps_report >= 1.0f) {
-            printf("FPS: %f\n", frames / fps_report);
-            frames = 0;
-            fps_report = 0.0f;
+        delta = (float)(end - start) / (float)NS_PER_SECOND;
+        update_audio();
+        fps_report += end - start;
+        if (fps_report >= NS_PER_SECOND) {
+            printf("FPS: %f Missed: %u Worst miss: %.3fms\n",
+                (double)pacer.frames * NS_PER_SECOND / fps_report, pacer.missed, (double)pacer.worst_miss_ns / NS_PER_MS);
+            AudioStats audio_stats;
+            get_audio_stats(&audio_stats);
+            if (audio_stats.callbacks > 0) {
+                double average = (double)audio_stats.total_callback_ns / audio_stats.callbacks;
+                printf("Audio: %u frames (%.2fms) Callback avg: %.3fms max: %.3fms Headroom: %.0f%% Late: %u Underruns: %u\n",
+                    audio_stats.buffer_frames, (double)audio_stats.period_ns / NS_PER_MS, average / NS_PER_MS, (double)audio_stats.max_callback_ns / NS_PER_MS,
+                    100.0 * (1.0 - ((double)audio_stats.max_callback_ns / audio_stats.period_ns)), audio_stats.late_callbacks, audio_stats.underruns);
+            }
+            DrawStats draw_frame, draw_totals;
+            get_draw_stats(&draw_frame, &draw_totals);
+            if (draw_totals.frames > 0) {
+                printf("Draw per frame: Quads: %.1f Culled: %.1f Texture binds: %.1f Target switches: %.1f Raster blits: %.1f\n",
+                    (double)draw_totals.submitted / draw_totals.frames, (double)draw_totals.culled / draw_totals.frames,
+                    (double)draw_totals.texture_binds / draw_totals.frames, (double)draw_totals.target_switches / draw_totals.frames,
+                    (double)draw_totals.rasterized / draw_totals.frames);
+            }
+            reset_draw_stats();
+            if (alloc_check) {
+                printf("Memory:");
+                for (int tag = 0; tag < NUM_MEMORY_TAGS; tag++) {
+                    MemoryStats memory;
+                    get_memory_stats(tag, &memory);
+                    printf(" %s: %.1fKB (peak %.1fKB, %llu allocs)", get_memory_tag_name(tag), (double)memory.bytes / 1024.0,
+                        (double)memory.peak_bytes / 1024.0, (unsigned long long)memory.allocations);
+                }
+                printf(" Steady state allocations: %u\n", get_guard_violations());
+            }
+            reset_pacer_stats(&pacer);
+            fps_report = 0;
         }
         start = end;
-        ticks = ((end / frequency) * 1000.0f) + 0.5f;
+        ticks = end / NS_PER_MS;
     }
     return EXIT_SUCCESS;
 }
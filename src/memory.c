@@ -0,0 +1,192 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "memory.h"
+
+/*
+ * Every tracked block starts with a header holding its size and tag so frees and reallocs can be accounted for.
+ * The header is the size of max_align_t so the pointer handed out keeps malloc's alignment.
+ */
+typedef union AllocationHeader
+{
+    struct {
+        size_t size;
+        int tag;
+    } info;
+    max_align_t align;
+} AllocationHeader;
+
+static const char *tag_names[NUM_MEMORY_TAGS] = {
+    [MEMORY_GAME] = "game",
+    [MEMORY_AUDIO] = "audio",
+    [MEMORY_ASSETS] = "assets",
+    [MEMORY_RENDER] = "render",
+    [MEMORY_SDL] = "SDL"
+};
+
+// Allocations can come from any thread (SDL's audio thread, the update thread, batch workers). They're rare enough that a spin lock is fine.
+static SDL_SpinLock lock;
+static MemoryStats stats[NUM_MEMORY_TAGS];
+static bool guard;
+static uint32_t guard_violations;
+// Guarded allocations not yet printed by report_guard_violations. Printing under the lock would stall every other allocating thread on stdio.
+static uint32_t pending_allocations[NUM_MEMORY_TAGS];
+static uint64_t pending_bytes[NUM_MEMORY_TAGS];
+
+static void count_allocation(int tag, size_t size)
+{
+    stats[tag].allocations += 1;
+    stats[tag].bytes += size;
+    if (stats[tag].bytes > stats[tag].peak_bytes) {
+        stats[tag].peak_bytes = stats[tag].bytes;
+    }
+    if (guard) {
+        guard_violations += 1;
+        pending_allocations[tag] += 1;
+        pending_bytes[tag] += size;
+    }
+}
+
+static void count_free(int tag, size_t size)
+{
+    stats[tag].frees += 1;
+    stats[tag].bytes -= size;
+}
+
+void *tracked_malloc(int tag, size_t size)
+{
+    AllocationHeader *header = malloc(sizeof(AllocationHeader) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.tag = tag;
+    SDL_AtomicLock(&lock);
+    count_allocation(tag, size);
+    SDL_AtomicUnlock(&lock);
+    return header + 1;
+}
+
+void *tracked_calloc(int tag, size_t count, size_t size)
+{
+    if (size != 0 && count > (SIZE_MAX - sizeof(AllocationHeader)) / size) {
+        return NULL;
+    }
+    void *ptr = tracked_malloc(tag, count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+// Keeps the block's original tag.
+void *tracked_realloc(int tag, void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return tracked_malloc(tag, size);
+    }
+    AllocationHeader *header = (AllocationHeader *)ptr - 1;
+    size_t old_size = header->info.size;
+    tag = header->info.tag;
+    header = realloc(header, sizeof(AllocationHeader) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->info.size = size;
+    SDL_AtomicLock(&lock);
+    count_free(tag, old_size);
+    count_allocation(tag, size);
+    SDL_AtomicUnlock(&lock);
+    return header + 1;
+}
+
+void tracked_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    AllocationHeader *header = (AllocationHeader *)ptr - 1;
+    SDL_AtomicLock(&lock);
+    count_free(header->info.tag, header->info.size);
+    SDL_AtomicUnlock(&lock);
+    free(header);
+}
+
+static void *SDLCALL sdl_malloc(size_t size)
+{
+    return tracked_malloc(MEMORY_SDL, size);
+}
+
+static void *SDLCALL sdl_calloc(size_t count, size_t size)
+{
+    return tracked_calloc(MEMORY_SDL, count, size);
+}
+
+static void *SDLCALL sdl_realloc(void *ptr, size_t size)
+{
+    return tracked_realloc(MEMORY_SDL, ptr, size);
+}
+
+static void SDLCALL sdl_free(void *ptr)
+{
+    tracked_free(ptr);
+}
+
+// Routes SDL's own allocations (render command queues, surfaces, WAV buffers) through the tracker. Must run before anything else calls SDL.
+void init_memory(void)
+{
+    if (SDL_SetMemoryFunctions(sdl_malloc, sdl_calloc, sdl_realloc, sdl_free) != 0) {
+        fprintf(stderr, "Warning: SDL_SetMemoryFunctions failed: %s\n", SDL_GetError());
+    }
+}
+
+void get_memory_stats(int tag, MemoryStats *out)
+{
+    SDL_AtomicLock(&lock);
+    *out = stats[tag];
+    SDL_AtomicUnlock(&lock);
+}
+
+const char *get_memory_tag_name(int tag)
+{
+    return tag_names[tag];
+}
+
+// While enabled every allocation is counted for report_guard_violations. Turned on once the main loop has warmed up since steady state frames shouldn't allocate at all.
+void set_allocation_guard(bool enabled)
+{
+    SDL_AtomicLock(&lock);
+    guard = enabled;
+    SDL_AtomicUnlock(&lock);
+}
+
+// Prints the guarded allocations made since the last call. Meant for the main thread once a frame, outside anything time critical.
+void report_guard_violations(void)
+{
+    uint32_t allocations[NUM_MEMORY_TAGS];
+    uint64_t bytes[NUM_MEMORY_TAGS];
+    SDL_AtomicLock(&lock);
+    memcpy(allocations, pending_allocations, sizeof(allocations));
+    memcpy(bytes, pending_bytes, sizeof(bytes));
+    memset(pending_allocations, 0, sizeof(pending_allocations));
+    memset(pending_bytes, 0, sizeof(pending_bytes));
+    SDL_AtomicUnlock(&lock);
+    for (int tag = 0; tag < NUM_MEMORY_TAGS; tag++) {
+        if (allocations[tag] > 0) {
+            fprintf(stderr, "Allocation guard: %u allocations (%llu bytes) by %s\n", allocations[tag], (unsigned long long)bytes[tag], tag_names[tag]);
+        }
+    }
+}
+
+uint32_t get_guard_violations(void)
+{
+    SDL_AtomicLock(&lock);
+    uint32_t violations = guard_violations;
+    SDL_AtomicUnlock(&lock);
+    return violations;
+}
@@ -0,0 +1,35 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Which subsystem an allocation belongs to.
+#define MEMORY_GAME 0
+#define MEMORY_AUDIO 1
+#define MEMORY_ASSETS 2
+#define MEMORY_RENDER 3
+#define MEMORY_SDL 4
+#define NUM_MEMORY_TAGS 5
+
+typedef struct MemoryStats
+{
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+    uint64_t peak_bytes;
+} MemoryStats;
+
+void init_memory(void);
+void *tracked_malloc(int tag, size_t size);
+void *tracked_calloc(int tag, size_t count, size_t size);
+void *tracked_realloc(int tag, void *ptr, size_t size);
+void tracked_free(void *ptr);
+void get_memory_stats(int tag, MemoryStats *stats);
+const char *get_memory_tag_name(int tag);
+void set_allocation_guard(bool enabled);
+void report_guard_violations(void);
+uint32_t get_guard_violations(void);
+
+#endif
@@ -0,0 +1,292 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "audio.h"
+#include "memory.h"
+#include "metrics.h"
+#include "pacer.h"
+
+/*
+ * Periodic newline delimited JSON for monitoring. The target is a file (appended to) or unix:<path> for a Unix domain socket.
+ * The main loop only pushes one FrameMetrics per frame into a lock free queue. Percentiles, audio and memory stats,
+ * formatting and writing all happen on the metrics thread so none of it shows up in frame time.
+ */
+
+// Frames buffered between writes. Must be a power of 2 and hold more than one interval at the highest frame rate.
+#define FRAME_QUEUE_SIZE 4096
+
+static SDL_Thread *thread;
+static SDL_mutex *mutex;
+static SDL_cond *cond;
+static bool stopping;
+static const char *socket_path;
+static FILE *file;
+static int socket_fd = -1;
+static FrameMetrics frames[FRAME_QUEUE_SIZE];
+static SDL_atomic_t frame_head;  // Only written by the metrics thread
+static SDL_atomic_t frame_tail;  // Only written by the main thread
+static SDL_atomic_t dropped_frames;
+// Only touched by the metrics thread.
+static int64_t frame_times[FRAME_QUEUE_SIZE];
+static GameCounts counts;  // From the latest frame. Kept when an interval has no frames
+static char line[2048];
+
+// Should only be called from the main loop. A full queue drops the frame and counts it.
+void record_frame_metrics(const FrameMetrics *frame)
+{
+    if (thread == NULL) {
+        return;
+    }
+    int tail = SDL_AtomicGet(&frame_tail);
+    int head = SDL_AtomicGet(&frame_head);
+    if (tail - head >= FRAME_QUEUE_SIZE) {
+        SDL_AtomicAdd(&dropped_frames, 1);
+        return;
+    }
+    frames[tail & (FRAME_QUEUE_SIZE - 1)] = *frame;
+    SDL_AtomicSet(&frame_tail, tail + 1);
+}
+
+static int compare_times(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted times, in milliseconds.
+static double percentile(const int64_t *sorted, int count, int percent)
+{
+    if (count == 0) {
+        return 0.0;
+    }
+    int rank = ((count * percent) + 99) / 100;
+    return (double)sorted[SDL_max(rank, 1) - 1] / NS_PER_MS;
+}
+
+#ifndef _WIN32
+static void connect_socket(void)
+{
+    socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        return;
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    if (connect(socket_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+}
+#endif
+
+// Lines written while a socket sink isn't listening are dropped. It's reconnected on the next interval.
+static void write_line(const char *text, size_t length)
+{
+    if (file) {
+        fwrite(text, 1, length, file);
+        fflush(file);
+        return;
+    }
+#ifndef _WIN32
+    if (socket_fd < 0) {
+        connect_socket();
+    }
+    // Stream sockets can take part of a line at a time.
+    size_t sent = 0;
+    while (socket_fd >= 0 && sent < length) {
+        ssize_t result = send(socket_fd, text + sent, length - sent, 0);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            close(socket_fd);
+            socket_fd = -1;
+            break;
+        }
+        sent += result;
+    }
+#endif
+}
+
+static void emit_metrics(void)
+{
+    int head = SDL_AtomicGet(&frame_head);
+    int tail = SDL_AtomicGet(&frame_tail);
+    int count = tail - head;
+    int64_t update_total = 0, update_max = 0, render_total = 0, render_max = 0;
+    for (int i = 0; i < count; i++) {
+        const FrameMetrics *frame = &frames[(head + i) & (FRAME_QUEUE_SIZE - 1)];
+        frame_times[i] = frame->frame_ns;
+        update_total += frame->update_ns;
+        update_max = SDL_max(update_max, frame->update_ns);
+        render_total += frame->render_ns;
+        render_max = SDL_max(render_max, frame->render_ns);
+        counts = frame->counts;
+    }
+    SDL_AtomicSet(&frame_head, tail);
+    qsort(frame_times, count, sizeof(int64_t), compare_times);
+
+    AudioStats audio;
+    get_audio_stats(&audio);
+    double audio_load = 0.0;
+    if (audio.callbacks > 0 && audio.period_ns > 0) {
+        audio_load = (double)audio.total_callback_ns / ((double)audio.callbacks * audio.period_ns);
+    }
+
+    int length = snprintf(line, sizeof(line),
+        "{\"time_ms\":%lld,\"frames\":%d,\"dropped_frames\":%d,"
+        "\"frame_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f},"
+        "\"update_ms\":{\"avg\":%.3f,\"max\":%.3f},\"render_ms\":{\"avg\":%.3f,\"max\":%.3f},"
+        "\"mobs\":{\"children\":%u,\"females\":%u,\"virgin_females\":%u},\"population\":%d,"
+        "\"audio\":{\"load\":%.4f,\"max_callback_ms\":%.3f,\"late_callbacks\":%u,\"underruns\":%u},\"memory\":{",
+        (long long)(get_time_ns() / NS_PER_MS), count, SDL_AtomicSet(&dropped_frames, 0),
+        percentile(frame_times, count, 50), percentile(frame_times, count, 90), percentile(frame_times, count, 99), percentile(frame_times, count, 100),
+        count ? (double)update_total / count / NS_PER_MS : 0.0, (double)update_max / NS_PER_MS,
+        count ? (double)render_total / count / NS_PER_MS : 0.0, (double)render_max / NS_PER_MS,
+        counts.children, counts.females, counts.virgin_females, (int)counts.population,
+        audio_load, (double)audio.max_callback_ns / NS_PER_MS, audio.late_callbacks, audio.underruns);
+    for (int tag = 0; tag < NUM_MEMORY_TAGS; tag++) {
+        MemoryStats memory;
+        get_memory_stats(tag, &memory);
+        length += snprintf(line + length, sizeof(line) - length, "%s\"%s\":%llu", tag ? "," : "", get_memory_tag_name(tag), (unsigned long long)memory.bytes);
+    }
+    length += snprintf(line + length, sizeof(line) - length, "}}\n");
+    write_line(line, length);
+}
+
+static int metrics_main(void *data)
+{
+    (void)data;
+    SDL_LockMutex(mutex);
+    while (!stopping) {
+        SDL_CondWaitTimeout(cond, mutex, METRICS_INTERVAL_MS);
+        if (stopping) {
+            break;
+        }
+        SDL_UnlockMutex(mutex);
+        emit_metrics();
+        SDL_LockMutex(mutex);
+    }
+    SDL_UnlockMutex(mutex);
+    // stop_metrics may have signalled while emit_metrics was running, so the last line is always written here rather than on a wake up.
+    emit_metrics();
+    return 0;
+}
+
+void start_metrics(const char *target)
+{
+    if (strncmp(target, "unix:", 5) == 0) {
+#ifdef _WIN32
+        fprintf(stderr, "Unix domain sockets aren't supported on this platform\n");
+        exit(EXIT_FAILURE);
+#else
+        socket_path = target + 5;
+        // A sink going away shouldn't kill the game.
+        signal(SIGPIPE, SIG_IGN);
+        connect_socket();
+        if (socket_fd < 0) {
+            fprintf(stderr, "Warning: Nothing listening on %s yet. Metrics are dropped until something is\n", socket_path);
+        }
+#endif
+    } else {
+        file = fopen(target, "a");
+        if (file == NULL) {
+            fprintf(stderr, "Failed to open %s\n", target);
+            exit(EXIT_FAILURE);
+        }
+    }
+    mutex = SDL_CreateMutex();
+    cond = SDL_CreateCond();
+    if (mutex == NULL || cond == NULL) {
+        fprintf(stderr, "Failed to create metrics mutex: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    thread = SDL_CreateThread(metrics_main, "metrics", NULL);
+    if (thread == NULL) {
+        fprintf(stderr, "SDL_CreateThread failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Writes whatever was recorded since the last line and closes the output. Does nothing if metrics weren't started.
+void stop_metrics(void)
+{
+    if (thread == NULL) {
+        return;
+    }
+    SDL_LockMutex(mutex);
+    stopping = true;
+    SDL_CondSignal(cond);
+    SDL_UnlockMutex(mutex);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+#ifndef _WIN32
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+#endif
+}
+
+/*
+ * A local sink for testing --metrics unix:<path>. Listens on path and copies every line it receives to stdout.
+ * Serves one instance at a time and keeps going when it disconnects.
+ */
+void run_metrics_sink(const char *path)
+{
+#ifdef _WIN32
+    (void)path;
+    fprintf(stderr, "Unix domain sockets aren't supported on this platform\n");
+    exit(EXIT_FAILURE);
+#else
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listen_fd, 1) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    printf("Listening for metrics on %s\n", path);
+    fflush(stdout);
+    char buffer[4096];
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            perror("accept");
+            exit(EXIT_FAILURE);
+        }
+        ssize_t received;
+        while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            fwrite(buffer, 1, received, stdout);
+            fflush(stdout);
+        }
+        close(fd);
+    }
+#endif
+}
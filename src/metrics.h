@@ -0,0 +1,25 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+// How often a metrics line is written.
+#define METRICS_INTERVAL_MS 1000
+
+// What the main loop hands over each frame. Everything else is sampled on the metrics thread.
+typedef struct FrameMetrics
+{
+    int64_t frame_ns;
+    int64_t update_ns;  // update_game, or waiting for it when pipelined
+    int64_t render_ns;
+    GameCounts counts;
+} FrameMetrics;
+
+void start_metrics(const char *target);
+void record_frame_metrics(const FrameMetrics *frame);
+void stop_metrics(void);
+void run_metrics_sink(const char *path);
+
+#endif
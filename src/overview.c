@@ -0,0 +1,472 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "assets.h"
+#include "draw.h"
+#include "game.h"
+#include "memory.h"
+#include "overview.h"
+
+/*
+ * Zoomed out views of the map.
+ * Every level of the pyramid is built once at load so drawing any zoom is a handful of chunk textures instead of one quad per tile.
+ * Levels down to one pixel per tile are composed from box filtered copies of the sprite sheet. Coarser levels box filter the level before,
+ * except that the first kept level past one pixel per tile is filtered from the tiles a strip at a time so big maps never hold a level over the cap.
+ * Tile edits compose just the edited area again and downsample it up through the coarser levels.
+ * Mobs are too small to draw one by one at these scales so they're shown as a density map of the mob grid cells instead.
+ */
+
+// Density map color. Alpha climbs with the number of mobs in a cell and saturates at DENSITY_FULL mobs.
+#define DENSITY_COLOR 0xff4080
+#define DENSITY_MIN_ALPHA 96
+#define DENSITY_FULL 32
+
+typedef struct Image
+{
+    int width;
+    int height;
+    uint32_t *pixels;
+} Image;
+
+static void init_image(Image *image, int width, int height)
+{
+    image->width = width;
+    image->height = height;
+    image->pixels = tracked_calloc(MEMORY_RENDER, (size_t)width * height, sizeof(uint32_t));
+    if (image->pixels == NULL) {
+        fprintf(stderr, "calloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Averages each 2x2 block into rect of dst. Odd edges repeat the last row or column. Sheet pixels are either opaque or 0 so averaging them is premultiplied alpha.
+static void downsample_rect(Image *dst, const Image *src, const SDL_Rect *rect)
+{
+    for (int y = rect->y; y < rect->y + rect->h; y++) {
+        int y0 = SDL_min(src->height - 1, y * 2);
+        int y1 = SDL_min(src->height - 1, (y * 2) + 1);
+        for (int x = rect->x; x < rect->x + rect->w; x++) {
+            int x0 = SDL_min(src->width - 1, x * 2);
+            int x1 = SDL_min(src->width - 1, (x * 2) + 1);
+            uint32_t a = src->pixels[(y0 * src->width) + x0];
+            uint32_t b = src->pixels[(y0 * src->width) + x1];
+            uint32_t c = src->pixels[(y1 * src->width) + x0];
+            uint32_t d = src->pixels[(y1 * src->width) + x1];
+            uint32_t pixel = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+                pixel |= ((sum + 2) / 4) << shift;
+            }
+            dst->pixels[(y * dst->width) + x] = pixel;
+        }
+    }
+}
+
+static void downsample_image(Image *dst, const Image *src)
+{
+    init_image(dst, SDL_max(1, (src->width + 1) / 2), SDL_max(1, (src->height + 1) / 2));
+    SDL_Rect rect = {0, 0, dst->width, dst->height};
+    downsample_rect(dst, src, &rect);
+}
+
+// Premultiplied source over destination.
+static uint32_t blend_over(uint32_t dst, uint32_t src)
+{
+    uint32_t inverse = 255 - (src >> 24);
+    uint32_t pixel = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t channel = ((src >> shift) & 0xff) + ((((dst >> shift) & 0xff) * inverse) / 255);
+        pixel |= SDL_min(channel, 255u) << shift;
+    }
+    return pixel;
+}
+
+// Draws srcrect (full size sheet coordinates) of the sheet mip for this level at (x, y), clipped to the image.
+static void blit_sprite(Image *image, const Image *sheet, int level, const SDL_Rect *srcrect, int x, int y)
+{
+    int src_x = srcrect->x >> level;
+    int src_y = srcrect->y >> level;
+    int width = srcrect->w >> level;
+    int height = srcrect->h >> level;
+    for (int row = SDL_max(0, -y); row < SDL_min(height, image->height - y); row++) {
+        const uint32_t *src = &sheet->pixels[((src_y + row) * sheet->width) + src_x];
+        uint32_t *dst = &image->pixels[((y + row) * image->width) + x];
+        for (int column = SDL_max(0, -x); column < SDL_min(width, image->width - x); column++) {
+            dst[column] = blend_over(dst[column], src[column]);
+        }
+    }
+}
+
+/*
+ * Same layering as render_game: backgrounds, then torches and tree trunks, then tree tops. Water is drawn in its first frame.
+ * The image is the map from tile (origin_x, origin_y) on and starts out transparent. Trees up and to the left of it can reach in so they're drawn too.
+ */
+static void compose_tiles(Image *image, int origin_x, int origin_y, const TileMap *tile_map, const Image *sheet, const SDL_Rect *sprites, int level)
+{
+    int size = TILE_SIZE >> level;
+    int min_x = SDL_max(0, origin_x - 1);
+    int min_y = SDL_max(0, origin_y - 1);
+    int max_x = SDL_min(tile_map->width, origin_x + (image->width / size));
+    int max_y = SDL_min(tile_map->height, origin_y + (image->height / size));
+    for (int y = min_y; y < max_y; y++) {
+        for (int x = min_x; x < max_x; x++) {
+            blit_sprite(image, sheet, level, &sprites[BACKGROUND(tile_map->tiles[(y * tile_map->width) + x])], (x - origin_x) * size, (y - origin_y) * size);
+        }
+    }
+    for (int y = min_y; y < max_y; y++) {
+        for (int x = min_x; x < max_x; x++) {
+            uint16_t foreground = FOREGROUND(tile_map->tiles[(y * tile_map->width) + x]);
+            if (foreground == SPRITE_TORCH) {
+                blit_sprite(image, sheet, level, &sprites[SPRITE_TORCH], (x - origin_x) * size, (y - origin_y) * size);
+            } else if (foreground == SPRITE_TREE_TOP) {
+                blit_sprite(image, sheet, level, &sprites[SPRITE_TREE_BOTTOM], (x - origin_x) * size, (y + 1 - origin_y) * size);
+            }
+        }
+    }
+    for (int y = min_y; y < max_y; y++) {
+        for (int x = min_x; x < max_x; x++) {
+            if (tile_map->tiles[(y * tile_map->width) + x] == TILE_TREE) {
+                blit_sprite(image, sheet, level, &sprites[SPRITE_TREE_TOP], (x - origin_x) * size, (y - origin_y) * size);
+            }
+        }
+    }
+}
+
+static void compose_level(Image *image, const TileMap *tile_map, const Image *sheet, const SDL_Rect *sprites, int level)
+{
+    int size = TILE_SIZE >> level;
+    init_image(image, tile_map->width * size, tile_map->height * size);
+    compose_tiles(image, 0, 0, tile_map, sheet, sprites, level);
+}
+
+static Image get_sheet_mip(const Overview *overview, int level)
+{
+    return (Image){SPRITE_SHEET_SIZE >> level, SPRITE_SHEET_SIZE >> level, overview->sheet_mips[level]};
+}
+
+/*
+ * Composes the tiles from (origin_x, origin_y) on at this level. The image is sized for the sheet level and starts out transparent.
+ * Past the sheet mips the tiles are composed at one pixel per tile and box filtered down in place, and the image shrinks to the result.
+ * That matches filtering the whole map level by level when the origin is a multiple of 2^(level - OVERVIEW_SHEET_MIPS) tiles and the image ends on one or at the map edge.
+ */
+static void compose_filtered(Image *image, int origin_x, int origin_y, const TileMap *tile_map, const Overview *overview, int level)
+{
+    Image mip = get_sheet_mip(overview, SDL_min(level, OVERVIEW_SHEET_MIPS));
+    compose_tiles(image, origin_x, origin_y, tile_map, &mip, overview->sprites, SDL_min(level, OVERVIEW_SHEET_MIPS));
+    for (int l = OVERVIEW_SHEET_MIPS; l < level; l++) {
+        // Every output pixel only reads pixels at or after its own index so the filter can write over its source.
+        Image src = *image;
+        image->width = SDL_max(1, (src.width + 1) / 2);
+        image->height = SDL_max(1, (src.height + 1) / 2);
+        SDL_Rect rect = {0, 0, image->width, image->height};
+        downsample_rect(image, &src, &rect);
+    }
+}
+
+// Builds a level past the sheet mips one row at a time from strips of tiles, so the finer levels are never held whole.
+static void compose_strips(Image *image, const TileMap *tile_map, const Overview *overview, int level)
+{
+    int shift = level - OVERVIEW_SHEET_MIPS;
+    int rows = 1 << shift;
+    int width = tile_map->width;
+    int height = tile_map->height;
+    for (int i = 0; i < shift; i++) {
+        width = SDL_max(1, (width + 1) / 2);
+        height = SDL_max(1, (height + 1) / 2);
+    }
+    init_image(image, width, height);
+    Image strip;
+    init_image(&strip, tile_map->width, rows);
+    for (int y = 0; y < tile_map->height; y += rows) {
+        Image row = {tile_map->width, SDL_min(rows, tile_map->height - y), strip.pixels};
+        memset(row.pixels, 0, (size_t)row.width * row.height * sizeof(uint32_t));
+        compose_filtered(&row, 0, y, tile_map, overview, level);
+        memcpy(&image->pixels[(y >> shift) * width], row.pixels, width * sizeof(uint32_t));
+    }
+    tracked_free(strip.pixels);
+}
+
+static SDL_Texture *create_texture(int width, int height, int access)
+{
+    SDL_Texture *texture = SDL_CreateTexture(renderer.sdl, SDL_PIXELFORMAT_ARGB8888, access, width, height);
+    if (texture == NULL) {
+        fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    return texture;
+}
+
+static void upload_level(OverviewLevel *level, const Image *image)
+{
+    level->chunks_x = (image->width + OVERVIEW_CHUNK_PIXELS - 1) / OVERVIEW_CHUNK_PIXELS;
+    level->chunks_y = (image->height + OVERVIEW_CHUNK_PIXELS - 1) / OVERVIEW_CHUNK_PIXELS;
+    level->textures = tracked_malloc(MEMORY_RENDER, level->chunks_x * level->chunks_y * sizeof(SDL_Texture *));
+    if (level->textures == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int cy = 0; cy < level->chunks_y; cy++) {
+        for (int cx = 0; cx < level->chunks_x; cx++) {
+            int x = cx * OVERVIEW_CHUNK_PIXELS;
+            int y = cy * OVERVIEW_CHUNK_PIXELS;
+            SDL_Texture *texture = create_texture(SDL_min(OVERVIEW_CHUNK_PIXELS, image->width - x), SDL_min(OVERVIEW_CHUNK_PIXELS, image->height - y), SDL_TEXTUREACCESS_STATIC);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+            SDL_UpdateTexture(texture, NULL, &image->pixels[(y * image->width) + x], image->width * sizeof(uint32_t));
+            level->textures[(cy * level->chunks_x) + cx] = texture;
+        }
+    }
+}
+
+// Replaces rect (level pixels) of the chunks it covers. pixels is the top left of rect and pitch is in pixels.
+static void upload_rect(const OverviewLevel *level, const uint32_t *pixels, int pitch, const SDL_Rect *rect)
+{
+    int min_x = rect->x / OVERVIEW_CHUNK_PIXELS;
+    int min_y = rect->y / OVERVIEW_CHUNK_PIXELS;
+    int max_x = (rect->x + rect->w - 1) / OVERVIEW_CHUNK_PIXELS;
+    int max_y = (rect->y + rect->h - 1) / OVERVIEW_CHUNK_PIXELS;
+    for (int cy = min_y; cy <= max_y; cy++) {
+        for (int cx = min_x; cx <= max_x; cx++) {
+            SDL_Rect chunk = {cx * OVERVIEW_CHUNK_PIXELS, cy * OVERVIEW_CHUNK_PIXELS, OVERVIEW_CHUNK_PIXELS, OVERVIEW_CHUNK_PIXELS};
+            SDL_Rect area;
+            SDL_IntersectRect(&chunk, rect, &area);
+            const uint32_t *src = &pixels[((area.y - rect->y) * pitch) + area.x - rect->x];
+            area.x -= chunk.x;
+            area.y -= chunk.y;
+            SDL_UpdateTexture(level->textures[(cy * level->chunks_x) + cx], &area, src, pitch * sizeof(uint32_t));
+        }
+    }
+}
+
+// The level that fits a map this many tiles across into the world target. Cheap, so callers can know it before building anything.
+int get_overview_max_level(int map_width, int map_height)
+{
+    int pixels_x = map_width * TILE_SIZE;
+    int pixels_y = map_height * TILE_SIZE;
+    int level = 1;
+    while (level < MAX_OVERVIEW_LEVELS && ((pixels_x >> level) > WORLD_WIDTH || (pixels_y >> level) > WORLD_HEIGHT)) {
+        level++;
+    }
+    return level;
+}
+
+/*
+ * Builds every level from first_level (the finest that fits OVERVIEW_MAX_LEVEL_PIXELS) to max_level (the whole map fits the world target).
+ * sheet is the ARGB8888 sprite sheet and sprites the tile sprite rects in it. cell_size is the world size of a density map cell.
+ */
+void init_overview(Overview *overview, const TileMap *tile_map, const uint32_t *sheet, const SDL_Rect *sprites, int cell_size)
+{
+    memset(overview, 0, sizeof(Overview));
+    overview->map_width = tile_map->width;
+    overview->map_height = tile_map->height;
+    int pixels_x = tile_map->width * TILE_SIZE;
+    int pixels_y = tile_map->height * TILE_SIZE;
+    overview->max_level = get_overview_max_level(tile_map->width, tile_map->height);
+    int level = 1;
+    while (level < overview->max_level && (int64_t)(pixels_x >> level) * (pixels_y >> level) > OVERVIEW_MAX_LEVEL_PIXELS) {
+        level++;
+    }
+    overview->first_level = level;
+
+    // The mips are kept for update_overview.
+    overview->sheet_mips[0] = (uint32_t *)sheet;
+    for (int i = 1; i <= OVERVIEW_SHEET_MIPS; i++) {
+        Image prev = get_sheet_mip(overview, i - 1);
+        Image mip;
+        downsample_image(&mip, &prev);
+        overview->sheet_mips[i] = mip.pixels;
+    }
+    overview->sprites = sprites;
+    Image image = {0, 0, NULL};
+    for (int l = overview->first_level; l <= overview->max_level; l++) {
+        if (l <= OVERVIEW_SHEET_MIPS) {
+            tracked_free(image.pixels);
+            Image mip = get_sheet_mip(overview, l);
+            compose_level(&image, tile_map, &mip, sprites, l);
+        } else if (l == overview->first_level) {
+            compose_strips(&image, tile_map, overview, l);
+        } else {
+            Image next;
+            downsample_image(&next, &image);
+            image = next;
+        }
+        OverviewLevel *level = &overview->levels[l];
+        level->width = image.width;
+        level->height = image.height;
+        if (l >= OVERVIEW_SHEET_MIPS) {
+            level->pixels = image.pixels;
+        }
+        upload_level(level, &image);
+    }
+    if (overview->max_level < OVERVIEW_SHEET_MIPS) {
+        tracked_free(image.pixels);
+    }
+
+    overview->cell_size = cell_size;
+    overview->density_width = (pixels_x + cell_size - 1) / cell_size;
+    overview->density_height = (pixels_y + cell_size - 1) / cell_size;
+    int num_cells = overview->density_width * overview->density_height;
+    overview->density_counts = tracked_calloc(MEMORY_RENDER, num_cells, sizeof(uint32_t));
+    overview->density_pixels = tracked_calloc(MEMORY_RENDER, num_cells, sizeof(uint32_t));
+    if (overview->density_counts == NULL || overview->density_pixels == NULL) {
+        fprintf(stderr, "calloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    overview->density = create_texture(overview->density_width, overview->density_height, SDL_TEXTUREACCESS_STREAMING);
+    SDL_SetTextureBlendMode(overview->density, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(overview->density, SDL_ScaleModeLinear);
+}
+
+void free_overview(Overview *overview)
+{
+    for (int l = 1; l <= overview->max_level; l++) {
+        OverviewLevel *level = &overview->levels[l];
+        for (int i = 0; i < level->chunks_x * level->chunks_y; i++) {
+            SDL_DestroyTexture(level->textures[i]);
+        }
+        tracked_free(level->textures);
+        tracked_free(level->pixels);
+    }
+    for (int i = 1; i <= OVERVIEW_SHEET_MIPS; i++) {
+        tracked_free(overview->sheet_mips[i]);
+    }
+    tracked_free(overview->scratch);
+    SDL_DestroyTexture(overview->density);
+    tracked_free(overview->density_counts);
+    tracked_free(overview->density_pixels);
+}
+
+/*
+ * Redraws the tiles in the rect after they were edited. Sheet levels compose just that area (plus the tile right and below that trees
+ * reach into) and the levels past them downsample it again, so the cost follows the size of the edit rather than the map.
+ * A first level past the sheet mips composes the area widened to whole blocks of the tiles it filters.
+ */
+void update_overview(Overview *overview, const TileMap *tile_map, const SDL_Rect *tiles)
+{
+    int min_x = SDL_max(0, tiles->x);
+    int min_y = SDL_max(0, tiles->y);
+    int max_x = SDL_min(tile_map->width, tiles->x + tiles->w + 1);
+    int max_y = SDL_min(tile_map->height, tiles->y + tiles->h + 1);
+    if (min_x >= max_x || min_y >= max_y) {
+        return;
+    }
+    SDL_Rect rect;
+    // The finest level with pixels kept. Levels after it are downsampled from it.
+    int kept = SDL_max(overview->first_level, OVERVIEW_SHEET_MIPS);
+    for (int l = overview->first_level; l <= SDL_min(overview->max_level, kept); l++) {
+        int shift = SDL_max(0, l - OVERVIEW_SHEET_MIPS);
+        int x0 = (min_x >> shift) << shift;
+        int y0 = (min_y >> shift) << shift;
+        int x1 = SDL_min(tile_map->width, ((max_x + (1 << shift) - 1) >> shift) << shift);
+        int y1 = SDL_min(tile_map->height, ((max_y + (1 << shift) - 1) >> shift) << shift);
+        int size = TILE_SIZE >> SDL_min(l, OVERVIEW_SHEET_MIPS);
+        size_t needed = (size_t)(x1 - x0) * size * (y1 - y0) * size * sizeof(uint32_t);
+        if (needed > overview->scratch_size) {
+            overview->scratch = tracked_realloc(MEMORY_RENDER, overview->scratch, needed);
+            if (overview->scratch == NULL) {
+                fprintf(stderr, "realloc failed\n");
+                exit(EXIT_FAILURE);
+            }
+            overview->scratch_size = needed;
+        }
+        memset(overview->scratch, 0, needed);
+        Image image = {(x1 - x0) * size, (y1 - y0) * size, overview->scratch};
+        compose_filtered(&image, x0, y0, tile_map, overview, l);
+        rect = (SDL_Rect){(x0 * size) >> shift, (y0 * size) >> shift, image.width, image.height};
+        OverviewLevel *level = &overview->levels[l];
+        if (level->pixels) {
+            for (int row = 0; row < rect.h; row++) {
+                memcpy(&level->pixels[((rect.y + row) * level->width) + rect.x], &image.pixels[row * rect.w], rect.w * sizeof(uint32_t));
+            }
+        }
+        upload_rect(level, image.pixels, rect.w, &rect);
+    }
+    for (int l = kept + 1; l <= overview->max_level; l++) {
+        OverviewLevel *prev = &overview->levels[l - 1];
+        OverviewLevel *level = &overview->levels[l];
+        int x = rect.x / 2;
+        int y = rect.y / 2;
+        rect.w = SDL_min(level->width, (rect.x + rect.w + 1) / 2) - x;
+        rect.h = SDL_min(level->height, (rect.y + rect.h + 1) / 2) - y;
+        rect.x = x;
+        rect.y = y;
+        Image src = {prev->width, prev->height, prev->pixels};
+        Image dst = {level->width, level->height, level->pixels};
+        downsample_rect(&dst, &src, &rect);
+        upload_rect(level, &level->pixels[(rect.y * level->width) + rect.x], level->width, &rect);
+    }
+}
+
+// Turns density_counts into the density texture. One texel per cell so this stays cheap on any map size.
+void update_density_map(Overview *overview)
+{
+    int num_cells = overview->density_width * overview->density_height;
+    for (int i = 0; i < num_cells; i++) {
+        uint32_t count = overview->density_counts[i];
+        uint32_t alpha = 0;
+        if (count > 0) {
+            alpha = DENSITY_MIN_ALPHA + (((255 - DENSITY_MIN_ALPHA) * SDL_min(count, DENSITY_FULL)) / DENSITY_FULL);
+        }
+        overview->density_pixels[i] = (alpha << 24) | DENSITY_COLOR;
+    }
+    SDL_UpdateTexture(overview->density, NULL, overview->density_pixels, overview->density_width * sizeof(uint32_t));
+}
+
+/*
+ * World position of the top left of the world target at this zoom. Follows the center but stops at the map edges.
+ * A map smaller than the view is centered instead.
+ */
+void get_overview_camera(const Overview *overview, int zoom, float center_x, float center_y, float *camera_x, float *camera_y)
+{
+    float view_w = (float)(WORLD_WIDTH << zoom);
+    float view_h = (float)(WORLD_HEIGHT << zoom);
+    float map_w = (float)(overview->map_width * TILE_SIZE);
+    float map_h = (float)(overview->map_height * TILE_SIZE);
+    if (map_w <= view_w) {
+        *camera_x = (map_w - view_w) * 0.5f;
+    } else {
+        *camera_x = SDL_min(SDL_max(center_x - (view_w * 0.5f), 0.0f), map_w - view_w);
+    }
+    if (map_h <= view_h) {
+        *camera_y = (map_h - view_h) * 0.5f;
+    } else {
+        *camera_y = SDL_min(SDL_max(center_y - (view_h * 0.5f), 0.0f), map_h - view_h);
+    }
+}
+
+/*
+ * Draws the map and mob density at 1 / 2^zoom scale. Zooms finer than first_level magnify it.
+ * Only chunks that overlap the view are drawn, so this is a few quads at any zoom.
+ */
+void render_overview(const Overview *overview, int zoom, float camera_x, float camera_y)
+{
+    int l = SDL_max(zoom, overview->first_level);
+    const OverviewLevel *level = &overview->levels[l];
+    float world_per_pixel = (float)(1 << zoom);
+    float chunk_world = (float)(OVERVIEW_CHUNK_PIXELS << l);
+    int min_x = SDL_max(0, (int)(camera_x / chunk_world));
+    int min_y = SDL_max(0, (int)(camera_y / chunk_world));
+    int max_x = SDL_min(level->chunks_x - 1, (int)((camera_x + (WORLD_WIDTH * world_per_pixel)) / chunk_world));
+    int max_y = SDL_min(level->chunks_y - 1, (int)((camera_y + (WORLD_HEIGHT * world_per_pixel)) / chunk_world));
+    float scale = (float)(1 << (l - zoom));
+    for (int cy = min_y; cy <= max_y; cy++) {
+        for (int cx = min_x; cx <= max_x; cx++) {
+            SDL_FRect dstrect;
+            dstrect.x = ((cx * chunk_world) - camera_x) / world_per_pixel;
+            dstrect.y = ((cy * chunk_world) - camera_y) / world_per_pixel;
+            dstrect.w = (float)SDL_min(OVERVIEW_CHUNK_PIXELS, level->width - (cx * OVERVIEW_CHUNK_PIXELS)) * scale;
+            dstrect.h = (float)SDL_min(OVERVIEW_CHUNK_PIXELS, level->height - (cy * OVERVIEW_CHUNK_PIXELS)) * scale;
+            draw_copy_f(level->textures[(cy * level->chunks_x) + cx], NULL, &dstrect);
+        }
+    }
+
+    SDL_FRect dstrect;
+    dstrect.x = -camera_x / world_per_pixel;
+    dstrect.y = -camera_y / world_per_pixel;
+    dstrect.w = (float)(overview->density_width * overview->cell_size) / world_per_pixel;
+    dstrect.h = (float)(overview->density_height * overview->cell_size) / world_per_pixel;
+    draw_copy_f(overview->density, NULL, &dstrect);
+}
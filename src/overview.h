@@ -0,0 +1,57 @@
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+
+#include "game.h"
+
+// Level l of the pyramid is the whole map drawn at 1 / 2^l scale. Level 0 is the normal tile renderer.
+#define MAX_OVERVIEW_LEVELS 12
+// Levels are cut into square textures this many pixels across so any level fits within texture size limits.
+#define OVERVIEW_CHUNK_PIXELS 256
+// Sprites are 16 pixels so the sheet can be halved 4 times before a tile is a single pixel.
+#define OVERVIEW_SHEET_MIPS 4
+// The finest level kept. Maps that would need more pixels than this magnify the first level that fits instead.
+#define OVERVIEW_MAX_LEVEL_PIXELS (2048 * 2048)
+
+typedef struct OverviewLevel
+{
+    int width;  // Pixels
+    int height;
+    int chunks_x;
+    int chunks_y;
+    SDL_Texture **textures;
+    uint32_t *pixels;  // Only levels from OVERVIEW_SHEET_MIPS and first_level up, which tile edits are downsampled into again
+} OverviewLevel;
+
+typedef struct Overview
+{
+    int map_width;  // Tiles
+    int map_height;
+    int first_level;  // Levels first_level to max_level have textures
+    int max_level;  // The level that fits the whole map in the world target
+    OverviewLevel levels[MAX_OVERVIEW_LEVELS + 1];
+    uint32_t *sheet_mips[OVERVIEW_SHEET_MIPS + 1];  // 0 is the caller's sheet
+    const SDL_Rect *sprites;
+    uint32_t *scratch;  // Edited areas are composed here
+    size_t scratch_size;
+    int cell_size;  // World pixels per density cell
+    int density_width;
+    int density_height;
+    uint32_t *density_counts;  // Mobs per cell. Filled by the caller before update_density_map
+    uint32_t *density_pixels;
+    SDL_Texture *density;
+} Overview;
+
+int get_overview_max_level(int map_width, int map_height);
+void init_overview(Overview *overview, const TileMap *tile_map, const uint32_t *sheet, const SDL_Rect *sprites, int cell_size);
+void free_overview(Overview *overview);
+void update_overview(Overview *overview, const TileMap *tile_map, const SDL_Rect *tiles);
+void update_density_map(Overview *overview);
+void get_overview_camera(const Overview *overview, int zoom, float center_x, float center_y, float *camera_x, float *camera_y);
+void render_overview(const Overview *overview, int zoom, float camera_x, float camera_y);
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdint.h>
+
+#include "SDL.h"
+
+#include "pacer.h"
+
+// Never spin for less than this. SDL_Delay routinely overshoots by around a millisecond.
+#define MIN_SPIN_NS (NS_PER_MS + (NS_PER_MS / 2))
+#define MAX_SPIN_NS (4 * NS_PER_MS)
+
+static uint64_t frequency;
+
+/*
+ * Converts the performance counter to nanoseconds without going through floating point.
+ * Splitting into whole seconds and remainder keeps (counter * 1e9) from overflowing for large counter values.
+ */
+int64_t get_time_ns(void)
+{
+    if (frequency == 0) {
+        frequency = SDL_GetPerformanceFrequency();
+    }
+    uint64_t counter = SDL_GetPerformanceCounter();
+    uint64_t seconds = counter / frequency;
+    uint64_t remainder = counter % frequency;
+    return (int64_t)((seconds * NS_PER_SECOND) + ((remainder * NS_PER_SECOND) / frequency));
+}
+
+void init_pacer(FramePacer *pacer, int target_fps)
+{
+    if (target_fps > 0) {
+        pacer->target_ns = NS_PER_SECOND / target_fps;
+    } else {
+        pacer->target_ns = 0;
+    }
+    pacer->spin_ns = MIN_SPIN_NS;
+    pacer->deadline = get_time_ns() + pacer->target_ns;
+    reset_pacer_stats(pacer);
+}
+
+void reset_pacer_stats(FramePacer *pacer)
+{
+    pacer->frames = 0;
+    pacer->missed = 0;
+    pacer->worst_miss_ns = 0;
+}
+
+/*
+ * Waits until the current frame's deadline then schedules the next one.
+ * Sleeps in whole milliseconds while the deadline is far away and spins for the last stretch.
+ * The spin window widens when SDL_Delay oversleeps and slowly shrinks back when it behaves, which keeps CPU use low without missing deadlines.
+ */
+void pace_frame(FramePacer *pacer)
+{
+    pacer->frames++;
+    if (pacer->target_ns == 0) {
+        return;
+    }
+    int64_t now = get_time_ns();
+    if (now > pacer->deadline) {
+        int64_t miss = now - pacer->deadline;
+        if (!pacer->vsync) {
+            pacer->missed++;
+            if (miss > pacer->worst_miss_ns) {
+                pacer->worst_miss_ns = miss;
+            }
+        }
+        // Don't try to catch up after a long stall (window drag, breakpoint, etc). Just restart the schedule from here.
+        if (miss >= pacer->target_ns) {
+            pacer->deadline = now + pacer->target_ns;
+        } else {
+            pacer->deadline += pacer->target_ns;
+        }
+        return;
+    }
+    while (pacer->deadline - now > pacer->spin_ns) {
+        int64_t sleep_ns = pacer->deadline - now - pacer->spin_ns;
+        Uint32 sleep_ms = sleep_ns / NS_PER_MS;
+        if (sleep_ms == 0) {
+            break;
+        }
+        SDL_Delay(sleep_ms);
+        int64_t after = get_time_ns();
+        int64_t oversleep = (after - now) - (sleep_ms * NS_PER_MS);
+        if (oversleep + (NS_PER_MS / 2) > pacer->spin_ns) {
+            pacer->spin_ns = SDL_min(oversleep + (NS_PER_MS / 2), MAX_SPIN_NS);
+        } else if (pacer->spin_ns > MIN_SPIN_NS) {
+            pacer->spin_ns -= pacer->spin_ns / 64;
+        }
+        now = after;
+    }
+    while (now < pacer->deadline) {
+        now = get_time_ns();
+    }
+    pacer->deadline += pacer->target_ns;
+}
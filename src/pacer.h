@@ -0,0 +1,26 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NS_PER_SECOND 1000000000LL
+#define NS_PER_MS 1000000LL
+
+typedef struct FramePacer
+{
+    int64_t target_ns;  // 0 means uncapped
+    int64_t deadline;
+    int64_t spin_ns;    // How close to the deadline we stop sleeping and start spinning
+    uint32_t frames;
+    uint32_t missed;
+    int64_t worst_miss_ns;
+    bool vsync;  // Set by the caller. Late frames are vsync waits rather than misses
+} FramePacer;
+
+int64_t get_time_ns(void);
+void init_pacer(FramePacer *pacer, int target_fps);
+void pace_frame(FramePacer *pacer);
+void reset_pacer_stats(FramePacer *pacer);
+
+#endif
@@ -10,15 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-typedef struct RngState
-{
-    uint64_t state;
-    uint64_t inc;
-} RngState;
-
-static RngState rng_state;
-
-void seed_rng(void)
+void seed_rng(RngState *rng)
 {
     #ifdef _WIN32
     uint64_t buffer[2];
@@ -37,8 +29,8 @@ void seed_rng(void)
         fprintf(stderr, "RtlGenRandom failed\n");
         exit(EXIT_FAILURE);
     }
-    rng_state.state = buffer[0];
-    rng_state.inc = buffer[1] | 1;
+    rng->state = buffer[0];
+    rng->inc = buffer[1] | 1;
     FreeLibrary(library);
     #else
     int fd = open("/dev/urandom", O_RDONLY);
@@ -56,24 +48,24 @@ void seed_rng(void)
         }
         exit(EXIT_FAILURE);
     }
-    rng_state.state = buffer[0];
-    rng_state.inc = buffer[1] | 1;
+    rng->state = buffer[0];
+    rng->inc = buffer[1] | 1;
     close(fd);
     #endif
 }
 
-uint32_t pcg_get_random(void)
+uint32_t pcg_get_random(RngState *rng)
 {
-    uint64_t oldstate = rng_state.state;
-    rng_state.state = oldstate * 6364136223846793005ULL + rng_state.inc;
+    uint64_t oldstate = rng->state;
+    rng->state = oldstate * 6364136223846793005ULL + rng->inc;
     uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
     uint32_t rot = oldstate >> 59u;
     return (xorshifted >> rot) | (xorshifted << ((0 - rot) & 31));
 }
 
-uint32_t pcg_ranged_random(uint32_t range)
+uint32_t pcg_ranged_random(RngState *rng, uint32_t range)
 {
-    uint32_t x = pcg_get_random();
+    uint32_t x = pcg_get_random(rng);
     uint64_t m = (uint64_t)x * (uint64_t)range;
     uint32_t l = (uint32_t)m;
     if (l < range)
@@ -81,7 +73,7 @@ uint32_t pcg_ranged_random(uint32_t range)
         uint32_t t = (0 - range) % range;
         while (l < t)
         {
-            x = pcg_get_random();
+            x = pcg_get_random(rng);
             m = (uint64_t)x * (uint64_t)range;
             l = (uint32_t)m;
         }
@@ -3,8 +3,15 @@
 
 #include <stdint.h>
 
-void seed_rng(void);
-uint32_t pcg_get_random(void);
-uint32_t pcg_ranged_random(uint32_t range);
+// Each generator is independent so separate worlds can run on separate threads. inc selects the stream and must be odd.
+typedef struct RngState
+{
+    uint64_t state;
+    uint64_t inc;
+} RngState;
+
+void seed_rng(RngState *rng);
+uint32_t pcg_get_random(RngState *rng);
+uint32_t pcg_ranged_random(RngState *rng, uint32_t range);
 
 #endif
@@ -0,0 +1,98 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDL.h"
+
+#include "game.h"
+#include "pipeline.h"
+
+/*
+ * Runs update_game on a worker thread so the next tick is simulated while the main thread renders the current one.
+ * Frame N on the main thread: finish_update (wait for tick N and swap it to the front), begin_update (start tick N + 1), render tick N.
+ * update_game only reads the front world state and render_game only reads it too so the two never race. The hand off is just swapping an index.
+ */
+static GameState *pipeline_game;
+static SDL_Thread *thread;
+static SDL_mutex *mutex;
+static SDL_cond *cond;
+static bool busy;
+static bool needs_swap;
+static bool quit;
+static float job_delta;
+static uint8_t job_input;
+
+static int update_thread(void *data)
+{
+    SDL_LockMutex(mutex);
+    while (1) {
+        while (!busy && !quit) {
+            SDL_CondWait(cond, mutex);
+        }
+        if (quit) {
+            break;
+        }
+        float delta = job_delta;
+        uint8_t input = job_input;
+        SDL_UnlockMutex(mutex);
+        update_game(pipeline_game, delta, input);
+        SDL_LockMutex(mutex);
+        busy = false;
+        SDL_CondBroadcast(cond);
+    }
+    SDL_UnlockMutex(mutex);
+    return 0;
+}
+
+void start_pipeline(GameState *game)
+{
+    pipeline_game = game;
+    mutex = SDL_CreateMutex();
+    cond = SDL_CreateCond();
+    if (mutex == NULL || cond == NULL) {
+        fprintf(stderr, "Failed to create pipeline mutex: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    thread = SDL_CreateThread(update_thread, "update", NULL);
+    if (thread == NULL) {
+        fprintf(stderr, "SDL_CreateThread failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+}
+
+void begin_update(float delta, uint8_t input)
+{
+    SDL_LockMutex(mutex);
+    job_delta = delta;
+    job_input = input;
+    busy = true;
+    needs_swap = true;
+    SDL_CondBroadcast(cond);
+    SDL_UnlockMutex(mutex);
+}
+
+// Waits for the tick in flight (if any) and makes it the front state. Safe to call more than once per frame.
+void finish_update(void)
+{
+    SDL_LockMutex(mutex);
+    while (busy) {
+        SDL_CondWait(cond, mutex);
+    }
+    SDL_UnlockMutex(mutex);
+    if (needs_swap) {
+        swap_game_state(pipeline_game);
+        needs_swap = false;
+    }
+}
+
+void stop_pipeline(void)
+{
+    finish_update();
+    SDL_LockMutex(mutex);
+    quit = true;
+    SDL_CondBroadcast(cond);
+    SDL_UnlockMutex(mutex);
+    SDL_WaitThread(thread, NULL);
+    SDL_DestroyCond(cond);
+    SDL_DestroyMutex(mutex);
+}
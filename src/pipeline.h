@@ -0,0 +1,13 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+void start_pipeline(GameState *game);
+void begin_update(float delta, uint8_t input);
+void finish_update(void);
+void stop_pipeline(void);
+
+#endif
@@ -0,0 +1,113 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RASTER_SSE2
+#endif
+
+#include "game.h"
+#include "raster.h"
+
+/*
+ * CPU renderer for the world view. Everything in the world is drawn 1:1 from the sprite sheet into a WORLD_WIDTH x WORLD_HEIGHT ARGB8888 framebuffer
+ * which gets uploaded with a single SDL_UpdateTexture per frame.
+ * Sprites use alpha as a color key: pixels with 0 alpha are skipped and everything else is copied as is.
+ */
+static uint32_t framebuffer[WORLD_WIDTH * WORLD_HEIGHT];
+static const uint32_t *sheet;
+static int sheet_pitch;
+
+void init_raster(const uint32_t *sprite_sheet, int sheet_width)
+{
+    sheet = sprite_sheet;
+    sheet_pitch = sheet_width;
+}
+
+void clear_raster(void)
+{
+    for (int i = 0; i < WORLD_WIDTH * WORLD_HEIGHT; i++) {
+        framebuffer[i] = 0xff000000;
+    }
+}
+
+static void blit_row(uint32_t *dst, const uint32_t *src, int count)
+{
+    int i = 0;
+    #ifdef RASTER_SSE2
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(pixels, alpha), zero);
+        __m128i background = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i result = _mm_or_si128(_mm_and_si128(transparent, background), _mm_andnot_si128(transparent, pixels));
+        _mm_storeu_si128((__m128i *)(dst + i), result);
+    }
+    #endif
+    for (; i < count; i++) {
+        if (src[i] & 0xff000000) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+// src points at the rightmost source pixel of the span and is read backwards.
+static void blit_row_flipped(uint32_t *dst, const uint32_t *src, int count)
+{
+    int i = 0;
+    #ifdef RASTER_SSE2
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src - i - 3));
+        pixels = _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(pixels, alpha), zero);
+        __m128i background = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i result = _mm_or_si128(_mm_and_si128(transparent, background), _mm_andnot_si128(transparent, pixels));
+        _mm_storeu_si128((__m128i *)(dst + i), result);
+    }
+    #endif
+    for (; i < count; i++) {
+        uint32_t pixel = *(src - i);
+        if (pixel & 0xff000000) {
+            dst[i] = pixel;
+        }
+    }
+}
+
+// Draws srcrect from the sprite sheet with its top left corner at x, y, clipped to the framebuffer. Returns false if nothing was on screen.
+bool raster_blit(const SDL_Rect *srcrect, int x, int y, bool flip)
+{
+    int x0 = SDL_max(x, 0);
+    int y0 = SDL_max(y, 0);
+    int x1 = SDL_min(x + srcrect->w, WORLD_WIDTH);
+    int y1 = SDL_min(y + srcrect->h, WORLD_HEIGHT);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    int count = x1 - x0;
+    int skip = x0 - x;
+    for (int row = y0; row < y1; row++) {
+        const uint32_t *src = sheet + ((srcrect->y + (row - y)) * sheet_pitch) + srcrect->x;
+        uint32_t *dst = framebuffer + (row * WORLD_WIDTH) + x0;
+        if (flip) {
+            blit_row_flipped(dst, src + srcrect->w - 1 - skip, count);
+        } else {
+            blit_row(dst, src + skip, count);
+        }
+    }
+    return true;
+}
+
+void present_raster(SDL_Texture *texture)
+{
+    if (SDL_UpdateTexture(texture, NULL, framebuffer, WORLD_WIDTH * sizeof(uint32_t)) != 0) {
+        fprintf(stderr, "SDL_UpdateTexture failed: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+
+void init_raster(const uint32_t *sprite_sheet, int sheet_width);
+void clear_raster(void);
+bool raster_blit(const SDL_Rect *srcrect, int x, int y, bool flip);
+void present_raster(SDL_Texture *texture);
+
+#endif
@@ -0,0 +1,334 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#include "game.h"
+#include "memory.h"
+#include "pcgrandom.h"
+#include "regions.h"
+
+// Edits whose area plus a one tile border covers more tiles than this rebuild every region instead of patching locally.
+#define MAX_LOCAL_TILES 1024
+#define LOCAL_NONE 0xffff
+
+static const int8_t neighbor_x[4] = {0, 0, 1, -1};
+static const int8_t neighbor_y[4] = {1, -1, 0, 0};
+
+static void *realloc_or_die(void *ptr, size_t size)
+{
+    ptr = tracked_realloc(MEMORY_GAME, ptr, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "realloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/*
+ * Labels every 4-connected group of non-SOLID tiles. Same connectivity as the flow field so mobs can walk anywhere within a region.
+ * region_tiles doubles as the flood fill queue which leaves each region's tiles next to each other ready for sampling.
+ * Runs once per level load (or snapshot restore) and is O(tiles).
+ */
+void build_regions(TileMap *tile_map)
+{
+    uint32_t num_tiles = tile_map->width * tile_map->height;
+    tile_map->regions = realloc_or_die(tile_map->regions, num_tiles * sizeof(uint32_t));
+    tile_map->region_tiles = realloc_or_die(tile_map->region_tiles, num_tiles * sizeof(uint32_t));
+    tile_map->region_start = realloc_or_die(tile_map->region_start, (num_tiles + 1) * sizeof(uint32_t));
+    memset(tile_map->regions, 0xff, num_tiles * sizeof(uint32_t));
+    tile_map->num_regions = 0;
+    uint32_t tail = 0;
+    for (uint32_t seed = 0; seed < num_tiles; seed++) {
+        if ((tile_map->tiles[seed] & SOLID) || tile_map->regions[seed] != REGION_NONE) {
+            continue;
+        }
+        uint32_t region = tile_map->num_regions++;
+        uint32_t head = tail;
+        tile_map->region_start[region] = head;
+        tile_map->regions[seed] = region;
+        tile_map->region_tiles[tail++] = seed;
+        while (head < tail) {
+            uint32_t tile = tile_map->region_tiles[head++];
+            int tile_x = tile % tile_map->width;
+            int tile_y = tile / tile_map->width;
+            for (int n = 0; n < 4; n++) {
+                int x = tile_x + neighbor_x[n];
+                int y = tile_y + neighbor_y[n];
+                if (x < 0 || y < 0 || x >= tile_map->width || y >= tile_map->height) {
+                    continue;
+                }
+                uint32_t next = (y * tile_map->width) + x;
+                if (!(tile_map->tiles[next] & SOLID) && tile_map->regions[next] == REGION_NONE) {
+                    tile_map->regions[next] = region;
+                    tile_map->region_tiles[tail++] = next;
+                }
+            }
+        }
+    }
+    tile_map->region_start[tile_map->num_regions] = tail;
+    tile_map->region_lists_stale = false;
+}
+
+/*
+ * Patches regions after the tiles in area changed. Walkable tiles in area plus a one tile border are flood filled locally.
+ * A local component touching two old regions joins them and an old region ending up in two components may have been cut in two.
+ * Either needs a global answer so build_regions runs. Otherwise components keep their old region (or get a new one if every tile in them
+ * is newly walkable) and the cost is O(area). Only the labels are patched, which leaves the region lists stale. Returns true if build_regions ran.
+ */
+bool update_regions(TileMap *tile_map, const SDL_Rect *area)
+{
+    bool changed = false;
+    for (int y = area->y; y < area->y + area->h; y++) {
+        for (int x = area->x; x < area->x + area->w; x++) {
+            uint32_t tile = (y * tile_map->width) + x;
+            if (((tile_map->tiles[tile] & SOLID) != 0) != (tile_map->regions[tile] == REGION_NONE)) {
+                changed = true;
+            }
+        }
+    }
+    if (!changed) {
+        return false;
+    }
+    int min_x = SDL_max(0, area->x - 1);
+    int min_y = SDL_max(0, area->y - 1);
+    int box_w = SDL_min(tile_map->width, area->x + area->w + 1) - min_x;
+    int box_h = SDL_min(tile_map->height, area->y + area->h + 1) - min_y;
+    if (box_w * box_h > MAX_LOCAL_TILES) {
+        build_regions(tile_map);
+        return true;
+    }
+
+    uint16_t component[MAX_LOCAL_TILES];
+    uint16_t queue[MAX_LOCAL_TILES];
+    uint32_t component_region[MAX_LOCAL_TILES];
+    int num_components = 0;
+    memset(component, 0xff, sizeof(component));
+    for (int seed = 0; seed < box_w * box_h; seed++) {
+        if (component[seed] != LOCAL_NONE || (tile_map->tiles[((min_y + (seed / box_w)) * tile_map->width) + min_x + (seed % box_w)] & SOLID)) {
+            continue;
+        }
+        int c = num_components++;
+        component_region[c] = REGION_NONE;
+        int head = 0;
+        int tail = 0;
+        component[seed] = c;
+        queue[tail++] = seed;
+        while (head < tail) {
+            int local = queue[head++];
+            int local_x = local % box_w;
+            int local_y = local / box_w;
+            uint32_t old = tile_map->regions[((min_y + local_y) * tile_map->width) + min_x + local_x];
+            if (old != REGION_NONE) {
+                if (component_region[c] == REGION_NONE) {
+                    component_region[c] = old;
+                } else if (component_region[c] != old) {
+                    build_regions(tile_map);
+                    return true;
+                }
+            }
+            for (int n = 0; n < 4; n++) {
+                int x = local_x + neighbor_x[n];
+                int y = local_y + neighbor_y[n];
+                if (x < 0 || y < 0 || x >= box_w || y >= box_h) {
+                    continue;
+                }
+                int next = (y * box_w) + x;
+                if (component[next] == LOCAL_NONE && !(tile_map->tiles[((min_y + y) * tile_map->width) + min_x + x] & SOLID)) {
+                    component[next] = c;
+                    queue[tail++] = next;
+                }
+            }
+        }
+    }
+    for (int a = 0; a < num_components; a++) {
+        for (int b = a + 1; b < num_components; b++) {
+            if (component_region[a] != REGION_NONE && component_region[a] == component_region[b]) {
+                build_regions(tile_map);
+                return true;
+            }
+        }
+    }
+    for (int c = 0; c < num_components; c++) {
+        if (component_region[c] == REGION_NONE) {
+            component_region[c] = tile_map->num_regions++;
+        }
+    }
+    for (int local = 0; local < box_w * box_h; local++) {
+        uint32_t tile = ((min_y + (local / box_w)) * tile_map->width) + min_x + (local % box_w);
+        tile_map->regions[tile] = component[local] == LOCAL_NONE ? REGION_NONE : component_region[component[local]];
+    }
+    tile_map->region_lists_stale = true;
+    return false;
+}
+
+void free_regions(TileMap *tile_map)
+{
+    tracked_free(tile_map->regions);
+    tracked_free(tile_map->region_tiles);
+    tracked_free(tile_map->region_start);
+    tile_map->regions = NULL;
+    tile_map->region_tiles = NULL;
+    tile_map->region_start = NULL;
+    tile_map->num_regions = 0;
+}
+
+// Region of the given tile or, if it's SOLID or off the map, of the closest walkable tile. REGION_NONE if there are none.
+uint32_t nearest_region(const TileMap *tile_map, int x, int y)
+{
+    if (x >= 0 && y >= 0 && x < tile_map->width && y < tile_map->height && tile_map->regions[(y * tile_map->width) + x] != REGION_NONE) {
+        return tile_map->regions[(y * tile_map->width) + x];
+    }
+    // Only used when setting up spawn zones so a full scan is fine.
+    uint32_t best = REGION_NONE;
+    int best_distance = INT32_MAX;
+    for (int ty = 0; ty < tile_map->height; ty++) {
+        for (int tx = 0; tx < tile_map->width; tx++) {
+            uint32_t region = tile_map->regions[(ty * tile_map->width) + tx];
+            int distance = abs(tx - x) + abs(ty - y);
+            if (region != REGION_NONE && distance < best_distance) {
+                best = region;
+                best_distance = distance;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Collects the tiles of region that fall inside area. If none do the whole region is used instead so a level
+ * that doesn't match the area still spawns somewhere reachable. Needs the region lists so not while they're stale.
+ */
+void init_spawn_zone(SpawnZone *zone, const TileMap *tile_map, uint32_t region, const SDL_Rect *area)
+{
+    if (tile_map->region_lists_stale) {
+        fprintf(stderr, "init_spawn_zone called with stale region lists\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t num_tiles = tile_map->width * tile_map->height;
+    if (zone->num_slots != num_tiles) {
+        zone->num_slots = num_tiles;
+        zone->slots = realloc_or_die(zone->slots, num_tiles * sizeof(uint32_t));
+    }
+    memset(zone->slots, 0xff, num_tiles * sizeof(uint32_t));
+    zone->region = region;
+    zone->area = *area;
+    zone->map_width = tile_map->width;
+    zone->size = 0;
+    if (region == REGION_NONE) {
+        return;
+    }
+    uint32_t start = tile_map->region_start[region];
+    uint32_t end = tile_map->region_start[region + 1];
+    if (zone->capacity < end - start) {
+        zone->capacity = end - start;
+        zone->tiles = realloc_or_die(zone->tiles, zone->capacity * sizeof(uint32_t));
+    }
+    for (uint32_t i = start; i < end; i++) {
+        int x = tile_map->region_tiles[i] % tile_map->width;
+        int y = tile_map->region_tiles[i] / tile_map->width;
+        if (x >= area->x && y >= area->y && x < area->x + area->w && y < area->y + area->h) {
+            zone->tiles[zone->size++] = tile_map->region_tiles[i];
+        }
+    }
+    if (zone->size == 0) {
+        memcpy(zone->tiles, tile_map->region_tiles + start, (end - start) * sizeof(uint32_t));
+        zone->size = end - start;
+        zone->area = (SDL_Rect){0, 0, tile_map->width, tile_map->height};
+    }
+    for (uint32_t i = 0; i < zone->size; i++) {
+        zone->slots[zone->tiles[i]] = i;
+    }
+}
+
+void free_spawn_zone(SpawnZone *zone)
+{
+    tracked_free(zone->tiles);
+    tracked_free(zone->slots);
+    zone->tiles = NULL;
+    zone->slots = NULL;
+    zone->size = 0;
+    zone->capacity = 0;
+    zone->num_slots = 0;
+}
+
+static bool in_rect(const SDL_Rect *rect, int x, int y)
+{
+    return x >= rect->x && y >= rect->y && x < rect->x + rect->w && y < rect->y + rect->h;
+}
+
+/*
+ * Keeps the zone in step with an edit to the tiles in area that update_regions patched without a rebuild. O(area).
+ * Tiles that left the region are dropped and tiles that joined it inside the zone's area are added. The zone can end up empty.
+ */
+void update_spawn_zone(SpawnZone *zone, const TileMap *tile_map, const SDL_Rect *area)
+{
+    for (int y = area->y; y < area->y + area->h; y++) {
+        for (int x = area->x; x < area->x + area->w; x++) {
+            uint32_t tile = (y * tile_map->width) + x;
+            bool belongs = in_rect(&zone->area, x, y) && tile_map->regions[tile] == zone->region;
+            uint32_t slot = zone->slots[tile];
+            if (slot != ZONE_NONE && !belongs) {
+                // The last tile takes the removed one's slot.
+                uint32_t last = zone->tiles[--zone->size];
+                zone->tiles[slot] = last;
+                zone->slots[last] = slot;
+                zone->slots[tile] = ZONE_NONE;
+            } else if (slot == ZONE_NONE && belongs) {
+                if (zone->size >= zone->capacity) {
+                    zone->capacity = zone->capacity ? zone->capacity * 2 : 64;
+                    zone->tiles = realloc_or_die(zone->tiles, zone->capacity * sizeof(uint32_t));
+                }
+                zone->slots[tile] = zone->size;
+                zone->tiles[zone->size++] = tile;
+            }
+        }
+    }
+}
+
+void random_spawn_tile(const SpawnZone *zone, RngState *rng, int *x, int *y)
+{
+    uint32_t tile = zone->tiles[pcg_ranged_random(rng, zone->size)];
+    *x = tile % zone->map_width;
+    *y = tile / zone->map_width;
+}
+
+#ifdef CHECK_REGIONS
+/*
+ * Debug check for update_regions: the labels must split the map exactly like a fresh build_regions does. Ids can differ so each
+ * side's ids are mapped to the other's and any id that maps two ways is a mismatch. Exits on one. O(tiles) and allocates, so it's
+ * only built with -DCHECK_REGIONS.
+ */
+void check_regions(const TileMap *tile_map)
+{
+    TileMap fresh = {.width = tile_map->width, .height = tile_map->height, .tiles = tile_map->tiles};
+    build_regions(&fresh);
+    uint32_t num_ids = SDL_max(SDL_max(tile_map->num_regions, fresh.num_regions), 1);
+    uint32_t *to_fresh = realloc_or_die(NULL, num_ids * sizeof(uint32_t));
+    uint32_t *from_fresh = realloc_or_die(NULL, num_ids * sizeof(uint32_t));
+    memset(to_fresh, 0xff, num_ids * sizeof(uint32_t));
+    memset(from_fresh, 0xff, num_ids * sizeof(uint32_t));
+    for (int tile = 0; tile < tile_map->width * tile_map->height; tile++) {
+        uint32_t patched = tile_map->regions[tile];
+        uint32_t built = fresh.regions[tile];
+        if ((patched == REGION_NONE) != (built == REGION_NONE)) {
+            fprintf(stderr, "Region check: tile %d, %d walkable in only one labelling\n", tile % tile_map->width, tile / tile_map->width);
+            exit(EXIT_FAILURE);
+        }
+        if (patched == REGION_NONE) {
+            continue;
+        }
+        if (to_fresh[patched] == REGION_NONE && from_fresh[built] == REGION_NONE) {
+            to_fresh[patched] = built;
+            from_fresh[built] = patched;
+        } else if (to_fresh[patched] != built || from_fresh[built] != patched) {
+            fprintf(stderr, "Region check: tile %d, %d is in region %u but a rebuild disagrees\n", tile % tile_map->width, tile / tile_map->width, patched);
+            exit(EXIT_FAILURE);
+        }
+    }
+    tracked_free(to_fresh);
+    tracked_free(from_fresh);
+    free_regions(&fresh);
+}
+#endif
@@ -0,0 +1,38 @@
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "pcgrandom.h"
+
+#define REGION_NONE 0xffffffff
+#define ZONE_NONE 0xffffffff
+
+// Walkable tiles mobs can spawn on. Sampling is a single random number no matter how much of the map is SOLID.
+typedef struct SpawnZone
+{
+    uint32_t region;
+    SDL_Rect area;  // Tiles of region inside this are in the zone
+    int map_width;
+    uint32_t *tiles;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t *slots;  // Index in tiles of every map tile or ZONE_NONE, so edits find zone tiles without searching
+    uint32_t num_slots;
+} SpawnZone;
+
+void build_regions(TileMap *tile_map);
+void free_regions(TileMap *tile_map);
+uint32_t nearest_region(const TileMap *tile_map, int x, int y);
+bool update_regions(TileMap *tile_map, const SDL_Rect *area);
+void init_spawn_zone(SpawnZone *zone, const TileMap *tile_map, uint32_t region, const SDL_Rect *area);
+void update_spawn_zone(SpawnZone *zone, const TileMap *tile_map, const SDL_Rect *area);
+void free_spawn_zone(SpawnZone *zone);
+void random_spawn_tile(const SpawnZone *zone, RngState *rng, int *x, int *y);
+#ifdef CHECK_REGIONS
+void check_regions(const TileMap *tile_map);
+#endif
+
+#endif
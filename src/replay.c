@@ -0,0 +1,118 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pcgrandom.h"
+#include "replay.h"
+
+/*
+ * File layout (native byte order, this is for comparing builds on the same machine):
+ *   "GREP" magic, uint32 version
+ *   uint64 rng state, uint64 rng increment (captured before the level is loaded since load_level consumes random numbers)
+ *   uint16 level path length, level path bytes
+ *   uint8 children behavior (version 2 on, version 1 replays were recorded with wandering children)
+ *   One record per update_game call: float delta, uint8 input bitmask
+ */
+#define REPLAY_MAGIC "GREP"
+#define REPLAY_VERSION 2
+
+static void write_or_die(const void *data, size_t size, FILE *file)
+{
+    if (fwrite(data, size, 1, file) != 1) {
+        fprintf(stderr, "fwrite failed for replay: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void read_or_die(void *data, size_t size, FILE *file)
+{
+    if (fread(data, size, 1, file) != 1) {
+        fprintf(stderr, "Replay file is truncated or unreadable\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void start_recording(Replay *replay, const char *filename, const char *level, const RngState *rng, uint8_t children_behavior)
+{
+    memset(replay, 0, sizeof(Replay));
+    size_t level_len = strlen(level);
+    if (level_len >= REPLAY_MAX_LEVEL) {
+        fprintf(stderr, "Level path too long to record: %s\n", level);
+        exit(EXIT_FAILURE);
+    }
+    replay->file = fopen(filename, "wb");
+    if (replay->file == NULL) {
+        fprintf(stderr, "fopen failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    replay->rng = *rng;
+    memcpy(replay->level, level, level_len);
+    replay->children_behavior = children_behavior;
+    uint32_t version = REPLAY_VERSION;
+    uint16_t length = level_len;
+    write_or_die(REPLAY_MAGIC, 4, replay->file);
+    write_or_die(&version, sizeof(version), replay->file);
+    write_or_die(&replay->rng.state, sizeof(replay->rng.state), replay->file);
+    write_or_die(&replay->rng.inc, sizeof(replay->rng.inc), replay->file);
+    write_or_die(&length, sizeof(length), replay->file);
+    write_or_die(level, level_len, replay->file);
+    write_or_die(&replay->children_behavior, sizeof(replay->children_behavior), replay->file);
+}
+
+void record_tick(Replay *replay, float delta, uint8_t input)
+{
+    write_or_die(&delta, sizeof(delta), replay->file);
+    write_or_die(&input, sizeof(input), replay->file);
+    replay->ticks++;
+}
+
+void open_replay(Replay *replay, const char *filename)
+{
+    memset(replay, 0, sizeof(Replay));
+    replay->file = fopen(filename, "rb");
+    if (replay->file == NULL) {
+        fprintf(stderr, "fopen failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    char magic[4];
+    uint32_t version;
+    uint16_t length;
+    read_or_die(magic, 4, replay->file);
+    read_or_die(&version, sizeof(version), replay->file);
+    if (memcmp(magic, REPLAY_MAGIC, 4) != 0 || version < 1 || version > REPLAY_VERSION) {
+        fprintf(stderr, "%s: Not a replay file or unsupported version\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    read_or_die(&replay->rng.state, sizeof(replay->rng.state), replay->file);
+    read_or_die(&replay->rng.inc, sizeof(replay->rng.inc), replay->file);
+    read_or_die(&length, sizeof(length), replay->file);
+    if (length >= REPLAY_MAX_LEVEL) {
+        fprintf(stderr, "%s: Invalid level path length: %hu\n", filename, length);
+        exit(EXIT_FAILURE);
+    }
+    read_or_die(replay->level, length, replay->file);
+    if (version >= 2) {
+        read_or_die(&replay->children_behavior, sizeof(replay->children_behavior), replay->file);
+    }
+    replay->rng.inc |= 1;
+}
+
+bool read_tick(Replay *replay, float *delta, uint8_t *input)
+{
+    if (fread(delta, sizeof(float), 1, replay->file) != 1 || fread(input, sizeof(uint8_t), 1, replay->file) != 1) {
+        return false;
+    }
+    replay->ticks++;
+    return true;
+}
+
+void close_replay(Replay *replay)
+{
+    if (replay->file) {
+        fclose(replay->file);
+        replay->file = NULL;
+    }
+}
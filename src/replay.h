@@ -0,0 +1,27 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pcgrandom.h"
+
+#define REPLAY_MAX_LEVEL 256
+
+typedef struct Replay
+{
+    FILE *file;
+    RngState rng;
+    char level[REPLAY_MAX_LEVEL];
+    uint8_t children_behavior;  // MOB_WANDER, MOB_SEEK or MOB_FLEE
+    uint32_t ticks;
+} Replay;
+
+void start_recording(Replay *replay, const char *filename, const char *level, const RngState *rng, uint8_t children_behavior);
+void record_tick(Replay *replay, float delta, uint8_t input);
+void open_replay(Replay *replay, const char *filename);
+bool read_tick(Replay *replay, float *delta, uint8_t *input);
+void close_replay(Replay *replay);
+
+#endif
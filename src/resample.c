@@ -0,0 +1,282 @@
+#include <math.h>
+#include <samplerate.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RESAMPLE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLE_NEON
+#endif
+
+#include "memory.h"
+#include "resample.h"
+
+/*
+ * Polyphase windowed sinc resampler.
+ * The ratio is reduced to up/down (160/147 for 44100 -> 48000) and a bank of up filters is built, one per fractional input position.
+ * Each output sample is a single dot product between one filter and a window of the input so there is no state carried between samples.
+ * That makes it trivial to split the output into chunks and run them on every core.
+ * Ratios that don't reduce to a reasonable number of phases fall back to libsamplerate.
+ */
+#define MAX_PHASES 1024
+// Below this many output frames (about 1 second) starting threads costs more than it saves.
+#define MIN_FRAMES_PER_THREAD 48000
+#define MAX_THREADS 32
+#define PI 3.14159265358979323846
+
+typedef struct Resampler
+{
+    uint32_t up;
+    uint32_t down;
+    int taps;
+    float *filters;
+} Resampler;
+
+typedef struct ResampleJob
+{
+    const Resampler *resampler;
+    const float *planar[2];
+    float *output;
+    int channels;
+    uint32_t start;
+    uint32_t end;
+} ResampleJob;
+
+typedef struct QualityTier
+{
+    int taps;
+    double rolloff;
+    double beta;
+    int src_converter;
+} QualityTier;
+
+static const QualityTier quality_tiers[] = {
+    [RESAMPLE_FAST] = {16, 0.90, 6.0, SRC_SINC_FASTEST},
+    [RESAMPLE_MEDIUM] = {32, 0.94, 8.0, SRC_SINC_MEDIUM_QUALITY},
+    [RESAMPLE_HIGH] = {64, 0.97, 10.0, SRC_SINC_BEST_QUALITY},
+    [RESAMPLE_REFERENCE] = {0, 0.0, 0.0, SRC_SINC_BEST_QUALITY}
+};
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Output length is defined as ceil(input * output_rate / input_rate) for every quality so buffers can be sized up front.
+uint32_t get_resampled_frames(uint32_t input_frames, int input_rate, int output_rate)
+{
+    return (((uint64_t)input_frames * output_rate) + input_rate - 1) / input_rate;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static void init_resampler(Resampler *resampler, int input_rate, int output_rate, const QualityTier *tier)
+{
+    uint32_t divisor = gcd(input_rate, output_rate);
+    resampler->up = output_rate / divisor;
+    resampler->down = input_rate / divisor;
+    resampler->taps = tier->taps;
+    resampler->filters = tracked_malloc(MEMORY_AUDIO, (size_t)resampler->up * resampler->taps * sizeof(float));
+    if (resampler->filters == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    // Cutoff relative to the input Nyquist. When downsampling it has to drop to the output Nyquist.
+    double cutoff = tier->rolloff;
+    if (output_rate < input_rate) {
+        cutoff *= (double)output_rate / (double)input_rate;
+    }
+    double half = resampler->taps / 2;
+    double window_scale = 1.0 / bessel_i0(tier->beta);
+    for (uint32_t phase = 0; phase < resampler->up; phase++) {
+        float *filter = resampler->filters + ((size_t)phase * resampler->taps);
+        double fraction = (double)phase / (double)resampler->up;
+        double sum = 0.0;
+        for (int k = 0; k < resampler->taps; k++) {
+            // Distance in input samples between this tap and the output position.
+            double d = (k - half + 1.0) - fraction;
+            double x = PI * cutoff * d;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+            double r = d / half;
+            double window = (fabs(r) >= 1.0) ? 0.0 : bessel_i0(tier->beta * sqrt(1.0 - (r * r))) * window_scale;
+            double value = cutoff * sinc * window;
+            filter[k] = value;
+            sum += value;
+        }
+        // Normalize each phase to unity gain at DC so there's no ripple at the phase rate.
+        for (int k = 0; k < resampler->taps; k++) {
+            filter[k] /= sum;
+        }
+    }
+}
+
+static float dot_product(const float *a, const float *b, int count)
+{
+    #if defined(RESAMPLE_SSE)
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    for (int i = 0; i < count; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    sum0 = _mm_add_ps(sum0, sum1);
+    sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+    sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+    return _mm_cvtss_f32(sum0);
+    #elif defined(RESAMPLE_NEON)
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < count; i += 8) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum0 = vaddq_f32(sum0, sum1);
+    float32x2_t pair = vadd_f32(vget_low_f32(sum0), vget_high_f32(sum0));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0);
+    #else
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+    #endif
+}
+
+/*
+ * The planar inputs are padded with taps zeros before and after the real data.
+ * Output frame n sits at input position n * down / up. The window for it starts taps / 2 - 1 samples before that.
+ */
+static int resample_job(void *data)
+{
+    ResampleJob *job = data;
+    const Resampler *resampler = job->resampler;
+    int offset = resampler->taps - ((resampler->taps / 2) - 1);
+    for (uint32_t n = job->start; n < job->end; n++) {
+        uint64_t position = (uint64_t)n * resampler->down;
+        uint32_t base = position / resampler->up;
+        uint32_t phase = position % resampler->up;
+        const float *filter = resampler->filters + ((size_t)phase * resampler->taps);
+        for (int c = 0; c < job->channels; c++) {
+            job->output[((size_t)n * job->channels) + c] = dot_product(filter, job->planar[c] + base + offset, resampler->taps);
+        }
+    }
+    return 0;
+}
+
+static void resample_libsamplerate(const float *input, uint32_t input_frames, int channels, int input_rate, float *output, uint32_t output_frames, int output_rate, int converter)
+{
+    SRC_DATA src_data;
+    memset(&src_data, 0, sizeof(SRC_DATA));
+    src_data.input_frames = input_frames;
+    src_data.output_frames = output_frames;
+    src_data.src_ratio = (double)output_rate / (double)input_rate;
+    src_data.data_in = input;
+    src_data.data_out = output;
+    int error = src_simple(&src_data, converter, channels);
+    if (error) {
+        fprintf(stderr, "src_simple failed: %s\n", src_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+    // libsamplerate can come up a few frames short of the exact length. Pad with silence.
+    if (src_data.output_frames_gen < output_frames) {
+        memset(output + (src_data.output_frames_gen * channels), 0, (output_frames - src_data.output_frames_gen) * channels * sizeof(float));
+    }
+}
+
+/*
+ * Resamples interleaved input into output which must hold get_resampled_frames() frames.
+ * Channels must be 1 or 2.
+ */
+void resample(const float *input, uint32_t input_frames, int channels, int input_rate, float *output, int output_rate, int quality)
+{
+    uint32_t output_frames = get_resampled_frames(input_frames, input_rate, output_rate);
+    const QualityTier *tier = &quality_tiers[quality];
+    uint32_t divisor = gcd(input_rate, output_rate);
+    if (tier->taps == 0 || output_rate / divisor > MAX_PHASES) {
+        resample_libsamplerate(input, input_frames, channels, input_rate, output, output_frames, output_rate, tier->src_converter);
+        return;
+    }
+    Resampler resampler;
+    init_resampler(&resampler, input_rate, output_rate, tier);
+
+    size_t padded_frames = (size_t)input_frames + (resampler.taps * 2);
+    float *planar = tracked_calloc(MEMORY_AUDIO, padded_frames * channels, sizeof(float));
+    if (planar == NULL) {
+        fprintf(stderr, "calloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    ResampleJob job;
+    memset(&job, 0, sizeof(ResampleJob));
+    job.resampler = &resampler;
+    job.output = output;
+    job.channels = channels;
+    for (int c = 0; c < channels; c++) {
+        float *dst = planar + (c * padded_frames) + resampler.taps;
+        for (uint32_t i = 0; i < input_frames; i++) {
+            dst[i] = input[((size_t)i * channels) + c];
+        }
+        job.planar[c] = planar + (c * padded_frames);
+    }
+
+    int num_threads = SDL_GetCPUCount();
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    if (num_threads > (int)(output_frames / MIN_FRAMES_PER_THREAD)) {
+        num_threads = output_frames / MIN_FRAMES_PER_THREAD;
+    }
+    if (num_threads <= 1) {
+        job.start = 0;
+        job.end = output_frames;
+        resample_job(&job);
+    } else {
+        // The main thread takes the last chunk itself.
+        ResampleJob jobs[MAX_THREADS];
+        SDL_Thread *threads[MAX_THREADS];
+        uint32_t chunk = output_frames / num_threads;
+        for (int t = 0; t < num_threads; t++) {
+            jobs[t] = job;
+            jobs[t].start = t * chunk;
+            jobs[t].end = (t == num_threads - 1) ? output_frames : (t + 1) * chunk;
+            threads[t] = NULL;
+            if (t < num_threads - 1) {
+                threads[t] = SDL_CreateThread(resample_job, "resample", &jobs[t]);
+            }
+            // Run it here if a thread couldn't be created.
+            if (threads[t] == NULL) {
+                resample_job(&jobs[t]);
+            }
+        }
+        for (int t = 0; t < num_threads; t++) {
+            if (threads[t]) {
+                SDL_WaitThread(threads[t], NULL);
+            }
+        }
+    }
+    tracked_free(planar);
+    tracked_free(resampler.filters);
+}
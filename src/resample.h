@@ -0,0 +1,15 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdint.h>
+
+// The first three use the in-tree polyphase resampler. Reference is libsamplerate's SRC_SINC_BEST_QUALITY which is very slow on long files.
+#define RESAMPLE_FAST 0
+#define RESAMPLE_MEDIUM 1
+#define RESAMPLE_HIGH 2
+#define RESAMPLE_REFERENCE 3
+
+uint32_t get_resampled_frames(uint32_t input_frames, int input_rate, int output_rate);
+void resample(const float *input, uint32_t input_frames, int channels, int input_rate, float *output, int output_rate, int quality);
+
+#endif
@@ -0,0 +1,223 @@
+#include "snapshot.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+
+/*
+ * File layout:
+ *   Page 0: SnapshotHeader followed by a table of (offset, size) for each section.
+ *   Each section starts on a page boundary and is a raw memory image.
+ * Saving is one write per section. Loading maps the file and hands out pointers into the mapping so the caller can restore each section with a single memcpy.
+ * Byte order and struct layout are the writer's. Snapshots are not meant to move between architectures.
+ */
+#define SNAPSHOT_MAGIC "GSNP"
+#define SNAPSHOT_ALIGN 4096
+
+typedef struct SnapshotHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t num_sections;
+    uint32_t reserved;
+    uint64_t offsets[SNAPSHOT_MAX_SECTIONS];
+    uint64_t sizes[SNAPSHOT_MAX_SECTIONS];
+} SnapshotHeader;
+
+static uint64_t build_header(SnapshotHeader *header, uint32_t version, const SnapshotSection *sections, uint32_t num_sections)
+{
+    if (num_sections > SNAPSHOT_MAX_SECTIONS) {
+        fprintf(stderr, "Too many snapshot sections: %u\n", num_sections);
+        exit(EXIT_FAILURE);
+    }
+    memset(header, 0, sizeof(SnapshotHeader));
+    memcpy(header->magic, SNAPSHOT_MAGIC, 4);
+    header->version = version;
+    header->num_sections = num_sections;
+    uint64_t offset = SNAPSHOT_ALIGN;
+    for (uint32_t i = 0; i < num_sections; i++) {
+        header->offsets[i] = offset;
+        header->sizes[i] = sections[i].size;
+        offset += (sections[i].size + SNAPSHOT_ALIGN - 1) & ~(uint64_t)(SNAPSHOT_ALIGN - 1);
+    }
+    return offset;
+}
+
+static void parse_header(Snapshot *snapshot, const char *filename, uint32_t version)
+{
+    const SnapshotHeader *header = snapshot->base;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: Not a snapshot file\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    if (header->version != version) {
+        fprintf(stderr, "%s: Unsupported snapshot version %u. Expected %u\n", filename, header->version, version);
+        exit(EXIT_FAILURE);
+    }
+    if (header->num_sections > SNAPSHOT_MAX_SECTIONS) {
+        fprintf(stderr, "%s: Invalid number of sections: %u\n", filename, header->num_sections);
+        exit(EXIT_FAILURE);
+    }
+    snapshot->num_sections = header->num_sections;
+    for (uint32_t i = 0; i < header->num_sections; i++) {
+        if (header->offsets[i] > snapshot->size || header->sizes[i] > snapshot->size - header->offsets[i]) {
+            fprintf(stderr, "%s: Section %u is out of bounds\n", filename, i);
+            exit(EXIT_FAILURE);
+        }
+        snapshot->sections[i].data = (const uint8_t *)snapshot->base + header->offsets[i];
+        snapshot->sections[i].size = header->sizes[i];
+    }
+}
+
+#ifdef _WIN32
+// No mmap or pwrite here. Fall back to stdio which still does one call per section.
+void write_snapshot(const char *filename, uint32_t version, const SnapshotSection *sections, uint32_t num_sections)
+{
+    SnapshotHeader header;
+    uint64_t end = build_header(&header, version, sections, num_sections);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "fopen failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (fwrite(&header, sizeof(SnapshotHeader), 1, file) != 1) {
+        fprintf(stderr, "fwrite failed for %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < num_sections; i++) {
+        _fseeki64(file, header.offsets[i], SEEK_SET);
+        if (sections[i].size > 0 && fwrite(sections[i].data, sections[i].size, 1, file) != 1) {
+            fprintf(stderr, "fwrite failed for %s\n", filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Pad out the last section so the file size matches what the section table describes.
+    _fseeki64(file, end - 1, SEEK_SET);
+    fputc(0, file);
+    fclose(file);
+}
+
+void open_snapshot(Snapshot *snapshot, const char *filename, uint32_t version)
+{
+    memset(snapshot, 0, sizeof(Snapshot));
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "fopen failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    _fseeki64(file, 0, SEEK_END);
+    snapshot->size = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_SET);
+    snapshot->base = tracked_malloc(MEMORY_GAME, snapshot->size);
+    if (snapshot->base == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fread(snapshot->base, snapshot->size, 1, file) != 1) {
+        fprintf(stderr, "fread failed for %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+    if (snapshot->size < sizeof(SnapshotHeader)) {
+        fprintf(stderr, "%s: Snapshot too small\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    parse_header(snapshot, filename, version);
+}
+
+void close_snapshot(Snapshot *snapshot)
+{
+    tracked_free(snapshot->base);
+    snapshot->base = NULL;
+}
+#else
+void write_snapshot(const char *filename, uint32_t version, const SnapshotSection *sections, uint32_t num_sections)
+{
+    SnapshotHeader header;
+    uint64_t end = build_header(&header, version, sections, num_sections);
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        fprintf(stderr, "open failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i <= num_sections; i++) {
+        const uint8_t *data;
+        uint64_t size;
+        uint64_t position;
+        if (i == 0) {
+            data = (const uint8_t *)&header;
+            size = sizeof(SnapshotHeader);
+            position = 0;
+        } else {
+            data = sections[i - 1].data;
+            size = sections[i - 1].size;
+            position = header.offsets[i - 1];
+        }
+        // pwrite may return short on very large sections so keep going until it's all out.
+        while (size > 0) {
+            ssize_t written = pwrite(fd, data, size, position);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fprintf(stderr, "pwrite failed for %s: %s\n", filename, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            data += written;
+            size -= written;
+            position += written;
+        }
+    }
+    // Make sure the file covers the last section's padding so the reader's bounds check is simple.
+    if (ftruncate(fd, end) == -1) {
+        fprintf(stderr, "ftruncate failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+void open_snapshot(Snapshot *snapshot, const char *filename, uint32_t version)
+{
+    memset(snapshot, 0, sizeof(Snapshot));
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "open failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        fprintf(stderr, "fstat failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    snapshot->size = st.st_size;
+    if (snapshot->size < sizeof(SnapshotHeader)) {
+        fprintf(stderr, "%s: Snapshot too small\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    snapshot->base = mmap(NULL, snapshot->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (snapshot->base == MAP_FAILED) {
+        fprintf(stderr, "mmap failed for %s: %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    parse_header(snapshot, filename, version);
+}
+
+void close_snapshot(Snapshot *snapshot)
+{
+    munmap(snapshot->base, snapshot->size);
+    snapshot->base = NULL;
+}
+#endif
@@ -0,0 +1,27 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_MAX_SECTIONS 8
+
+typedef struct SnapshotSection
+{
+    const void *data;
+    uint64_t size;
+} SnapshotSection;
+
+typedef struct Snapshot
+{
+    void *base;
+    size_t size;
+    uint32_t num_sections;
+    SnapshotSection sections[SNAPSHOT_MAX_SECTIONS];
+} Snapshot;
+
+void write_snapshot(const char *filename, uint32_t version, const SnapshotSection *sections, uint32_t num_sections);
+void open_snapshot(Snapshot *snapshot, const char *filename, uint32_t version);
+void close_snapshot(Snapshot *snapshot);
+
+#endif
@@ -0,0 +1,105 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "SDL.h"
+
+#include "game.h"
+#include "tilemap.h"
+
+/*
+ * Runtime tile edits. A tree is drawn over a 2x2 block from its top left tile and all four tiles are SOLID.
+ * Only the top left stores the tree so the other three carry a SOLID bit that has to be worked out again when trees come and go.
+ */
+
+// Marks the rest of the 2x2 footprint of a tree at (x, y) SOLID.
+void set_tree_collision(TileMap *tile_map, int x, int y)
+{
+    if (x + 1 < tile_map->width) {
+        tile_map->tiles[(y * tile_map->width) + x + 1] |= SOLID;
+    }
+    if (y + 1 < tile_map->height) {
+        tile_map->tiles[((y + 1) * tile_map->width) + x] |= SOLID;
+        if (x + 1 < tile_map->width) {
+            tile_map->tiles[((y + 1) * tile_map->width) + x + 1] |= SOLID;
+        }
+    }
+}
+
+static bool is_tree(const TileMap *tile_map, int x, int y)
+{
+    return x >= 0 && y >= 0 && FOREGROUND(tile_map->tiles[(y * tile_map->width) + x]) == SPRITE_TREE_TOP;
+}
+
+// Whether the tile is SOLID by itself (rock, water, ice or a tree) or because a tree up and to the left covers it.
+static bool should_be_solid(const TileMap *tile_map, int x, int y)
+{
+    uint16_t background = BACKGROUND(tile_map->tiles[(y * tile_map->width) + x]);
+    if (background == SPRITE_ROCK || background == SPRITE_WATER_0 || background == SPRITE_ICE) {
+        return true;
+    }
+    return is_tree(tile_map, x, y) || is_tree(tile_map, x - 1, y) || is_tree(tile_map, x, y - 1) || is_tree(tile_map, x - 1, y - 1);
+}
+
+/*
+ * Replaces the tile at (x, y) with one of the TILE_ values (optionally with a foreground, like load_level builds them).
+ * Fixes up tree collision in the 2x2 block the tile can affect and records that block in tile_map->dirty.
+ * Returns false and changes nothing if (x, y) is off the map or already holds tile. Otherwise changed is the block.
+ */
+bool set_tile(TileMap *tile_map, int x, int y, uint16_t tile, SDL_Rect *changed)
+{
+    if (x < 0 || y < 0 || x >= tile_map->width || y >= tile_map->height) {
+        return false;
+    }
+    uint16_t *current = &tile_map->tiles[(y * tile_map->width) + x];
+    if ((*current & ~SOLID) == (tile & ~SOLID)) {
+        return false;
+    }
+    *current = tile & ~SOLID;
+    changed->x = x;
+    changed->y = y;
+    changed->w = SDL_min(2, tile_map->width - x);
+    changed->h = SDL_min(2, tile_map->height - y);
+    for (int ty = y; ty < y + changed->h; ty++) {
+        for (int tx = x; tx < x + changed->w; tx++) {
+            uint16_t *block = &tile_map->tiles[(ty * tile_map->width) + tx];
+            if (should_be_solid(tile_map, tx, ty)) {
+                *block |= SOLID;
+            } else {
+                *block &= ~SOLID;
+            }
+        }
+    }
+    add_dirty_tiles(&tile_map->dirty, changed);
+    return true;
+}
+
+// True if the rects overlap or share an edge.
+bool rects_overlap(const SDL_Rect *a, const SDL_Rect *b)
+{
+    return a->x <= b->x + b->w && b->x <= a->x + a->w && a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+static void union_rect(SDL_Rect *rect, const SDL_Rect *other)
+{
+    int min_x = SDL_min(rect->x, other->x);
+    int min_y = SDL_min(rect->y, other->y);
+    rect->w = SDL_max(rect->x + rect->w, other->x + other->w) - min_x;
+    rect->h = SDL_max(rect->y + rect->h, other->y + other->h) - min_y;
+    rect->x = min_x;
+    rect->y = min_y;
+}
+
+// Edits are usually clustered (digging a tunnel, planting a row) so touching rects are merged to keep the list short.
+void add_dirty_tiles(DirtyTiles *dirty, const SDL_Rect *rect)
+{
+    for (int i = 0; i < dirty->count; i++) {
+        if (rects_overlap(&dirty->rects[i], rect)) {
+            union_rect(&dirty->rects[i], rect);
+            return;
+        }
+    }
+    if (dirty->count < MAX_DIRTY_RECTS) {
+        dirty->rects[dirty->count++] = *rect;
+    } else {
+        union_rect(&dirty->rects[MAX_DIRTY_RECTS - 1], rect);
+    }
+}
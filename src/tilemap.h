@@ -0,0 +1,16 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+
+#include "game.h"
+
+void set_tree_collision(TileMap *tile_map, int x, int y);
+bool set_tile(TileMap *tile_map, int x, int y, uint16_t tile, SDL_Rect *changed);
+void add_dirty_tiles(DirtyTiles *dirty, const SDL_Rect *rect);
+bool rects_overlap(const SDL_Rect *a, const SDL_Rect *b);
+
+#endif